@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <new>
+
+#include <fcntl.h>
+#include <grp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cast/cast.h>
+#include "relay.h"
+
+#define PRINT           std::cout << std::endl
+#define ERROR           std::cerr << std::endl
+
+static relay::Header* ring_ = nullptr;
+static size_t ringSize_ = 0;
+// the geometry and the write positions are private, the shared copies can be rewritten by any process mapping the ring
+static relay::Ring frames_ = {};
+static relay::Ring events_ = {};
+static uint64_t frameHead_ = 0;
+static uint64_t eventHead_ = 0;
+static std::string objName_;
+static std::mutex write_;
+static std::atomic_bool quit_(false);
+
+/// publishes a message into the ring
+/// @param[in] type the message type
+/// @param[in] fill fills the header fields of the slot
+/// @param[in] data the data to copy after the header
+/// @param[in] sz size of the data in bytes
+/// @details callbacks arrive on different library threads, writes are serialized so each ring has a single writer.
+///          images go to the frame ring, everything else to the event ring. the slot sequence is made odd before the
+///          slot is touched and even once it is complete, and the head only moves afterwards, so readers never see a
+///          partially written message as current
+template <class Fill> void publish(relay::Type type, Fill fill, const void* data, size_t sz)
+{
+    if (!ring_)
+        return;
+    const bool frame = relay::isFrame(type);
+    const relay::Ring& ring = frame ? frames_ : events_;
+    if (sizeof(relay::Slot) + sz > ring.slotSize_)
+    {
+        ring_->oversize_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(write_);
+    uint64_t& head = frame ? frameHead_ : eventHead_;
+    const uint64_t index = head++;
+    relay::Slot* s = ring.slot(ring_, index);
+
+    s->seq_.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s->type_ = type;
+    s->size_ = static_cast<uint32_t>(sz);
+    s->npos_ = 0;
+    s->value_[0] = s->value_[1] = 0;
+    fill(s);
+    if (sz)
+        memcpy(s->data(), data, sz);
+
+    s->seq_.store(2 * (index + 1), std::memory_order_release);
+    (frame ? ring_->head_ : ring_->eventHead_).store(index + 1, std::memory_order_release);
+    relay::wake(ring_);
+}
+
+/// stores the imu samples embedded with a frame
+/// @param[in] s the slot
+/// @param[in] npos the # of positional data points
+/// @param[in] pos the buffer of positional data
+void storePos(relay::Slot* s, int npos, const CusPosInfo* pos)
+{
+    s->npos_ = (npos > relay::kMaxPos) ? relay::kMaxPos : npos;
+    if (s->npos_ > 0 && pos)
+        memcpy(s->pos_, pos, s->npos_ * sizeof(CusPosInfo));
+    else
+        s->npos_ = 0;
+}
+
+/// creates the shared memory rings
+/// @param[in] name the relay name
+/// @param[in] slots # of frame slots
+/// @param[in] slotSize maximum size of an image message including its header
+/// @param[in] eventSlots # of event slots, each holds an imu sample or an event
+/// @param[in] group group allowed to read the ring, negative to restrict it to the current user
+/// @return success of the call
+bool createRing(const std::string& name, uint32_t slots, uint64_t slotSize, uint32_t eventSlots, int group)
+{
+    char obj[128];
+    relay::objectName(name.c_str(), obj, sizeof(obj));
+    objName_ = obj;
+
+    const uint64_t align = relay::kAlign - 1;
+    frames_.offset_ = sizeof(relay::Header);
+    frames_.slots_ = slots;
+    frames_.slotSize_ = (slotSize + align) & ~align;
+    // event slots only need room for the longest error message
+    events_.offset_ = frames_.offset_ + frames_.size();
+    events_.slots_ = eventSlots;
+    events_.slotSize_ = (sizeof(relay::Slot) + relay::kMaxText + align) & ~align;
+    ringSize_ = relay::totalSize(frames_, events_);
+
+    // remove a ring left behind by a daemon that did not exit cleanly, readers still mapping it see it as dead
+    shm_unlink(obj);
+    // readers need write access for the futex, the umask would take it away from the group
+    const mode_t mask = umask(0);
+    const int fd = shm_open(obj, O_CREAT | O_EXCL | O_RDWR, (group < 0) ? 0600 : 0660);
+    umask(mask);
+    if (fd < 0)
+        return false;
+    if ((group >= 0 && fchown(fd, static_cast<uid_t>(-1), static_cast<gid_t>(group)) < 0) || ftruncate(fd, static_cast<off_t>(ringSize_)) < 0)
+    {
+        close(fd);
+        shm_unlink(obj);
+        return false;
+    }
+    void* mem = mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        shm_unlink(obj);
+        return false;
+    }
+
+    // the object is zero filled, so only the header needs to be set, the magic is written last to publish the layout
+    ring_ = new (mem) relay::Header;
+    ring_->version_ = relay::kVersion;
+    ring_->slots_ = frames_.slots_;
+    ring_->slotSize_ = frames_.slotSize_;
+    ring_->eventSlots_ = events_.slots_;
+    ring_->eventSlotSize_ = events_.slotSize_;
+    ring_->pid_ = static_cast<uint32_t>(getpid());
+    ring_->head_.store(0);
+    ring_->eventHead_.store(0);
+    ring_->oversize_.store(0);
+    ring_->futex_.store(0);
+    ring_->waiters_.store(0);
+    ring_->alive_.store(1);
+    std::atomic_thread_fence(std::memory_order_release);
+    ring_->magic_ = relay::kMagic;
+    return true;
+}
+
+/// removes the shared memory ring, waking readers so they notice the daemon is gone
+void destroyRing()
+{
+    if (!ring_)
+        return;
+    ring_->alive_.store(0, std::memory_order_release);
+    relay::wake(ring_);
+    munmap(ring_, ringSize_);
+    shm_unlink(objName_.c_str());
+    ring_ = nullptr;
+}
+
+/// callback for error messages
+/// @param[in] err the error message sent from the casting module
+void errorFn(const char* err)
+{
+    ERROR << "error: " << err;
+    const size_t len = strnlen(err, relay::kMaxText - 1);
+    publish(relay::Type::Error, [](relay::Slot*) {}, err, len);
+}
+
+/// callback for freeze state change
+/// @param[in] val the freeze state value, 1 = frozen, 0 = imaging
+void freezeFn(int val)
+{
+    PRINT << (val ? "frozen" : "imaging");
+    publish(relay::Type::Freeze, [val](relay::Slot* s) { s->value_[0] = val; }, nullptr, 0);
+}
+
+/// callback for button press
+/// @param[in] btn the button that was pressed, 0 = up, 1 = down
+/// @param[in] clicks # of clicks used
+void buttonFn(CusButton btn, int clicks)
+{
+    publish(relay::Type::Button, [btn, clicks](relay::Slot* s)
+    {
+        s->value_[0] = static_cast<int32_t>(btn);
+        s->value_[1] = clicks;
+    }, nullptr, 0);
+}
+
+/// callback for streamed imu data
+/// @param[in] pos the positional information data streamed
+void newImuDataFn(const CusPosInfo* pos)
+{
+    publish(relay::Type::Imu, [pos](relay::Slot* s) { storePos(s, 1, pos); }, nullptr, 0);
+}
+
+/// callback for a new pre-scan converted data sent from the scanner
+/// @param[in] newImage a pointer to the raw image bits
+/// @param[in] nfo the image properties
+/// @param[in] npos the # of positional data points embedded with the frame
+/// @param[in] pos the buffer of positional data
+void newRawImageFn(const void* newImage, const CusRawImageInfo* nfo, int npos, const CusPosInfo* pos)
+{
+    const size_t sz = nfo->jpeg ? static_cast<size_t>(nfo->jpeg) : static_cast<size_t>(nfo->lines) * nfo->samples * (nfo->bitsPerSample / 8);
+    publish(relay::Type::Raw, [nfo, npos, pos](relay::Slot* s)
+    {
+        s->raw_ = *nfo;
+        storePos(s, npos, pos);
+    }, newImage, sz);
+}
+
+/// callback for a new image sent from the scanner
+/// @param[in] newImage a pointer to the raw image bits
+/// @param[in] nfo the image properties
+/// @param[in] npos the # of positional data points embedded with the frame
+/// @param[in] pos the buffer of positional data
+void newProcessedImageFn(const void* newImage, const CusProcessedImageInfo* nfo, int npos, const CusPosInfo* pos)
+{
+    publish(relay::Type::Processed, [nfo, npos, pos](relay::Slot* s)
+    {
+        s->processed_ = *nfo;
+        storePos(s, npos, pos);
+    }, newImage, static_cast<size_t>(nfo->imageSize));
+}
+
+/// callback for a new spectral image sent from the scanner
+/// @param[in] newImage a pointer to the raw image bits
+/// @param[in] nfo the image properties
+void newSpectralImageFn(const void* newImage, const CusSpectralImageInfo* nfo)
+{
+    const size_t sz = static_cast<size_t>(nfo->lines) * nfo->samples * (nfo->bitsPerSample / 8);
+    publish(relay::Type::Spectral, [nfo](relay::Slot* s) { s->spectral_ = *nfo; }, newImage, sz);
+}
+
+/// signal handler to exit cleanly, so the ring is removed
+void onSignal(int)
+{
+    quit_ = true;
+}
+
+int init(int& argc, char** argv)
+{
+    int width  = 640;
+    int height = 480;
+    std::string keydir = "/tmp/", ipAddr, name = "default", groupName;
+    unsigned int port = 0;
+    uint32_t slots = 16, eventSlots = 1024;
+    uint64_t slotSize = 0;
+    int o;
+
+    // check command line options
+    while ((o = getopt(argc, argv, "k:a:p:n:s:b:e:w:h:g:")) != -1)
+    {
+        try
+        {
+            switch (o)
+            {
+            // security key directory
+            case 'k': keydir = optarg; break;
+            // ip address
+            case 'a': ipAddr = optarg; break;
+            // port
+            case 'p': port = std::stoi(optarg); break;
+            // relay name
+            case 'n': name = optarg; break;
+            // # of slots
+            case 's': slots = std::stoi(optarg); break;
+            // slot size in bytes
+            case 'b': slotSize = std::stoull(optarg); break;
+            // # of imu and event slots
+            case 'e': eventSlots = std::stoi(optarg); break;
+            // output size
+            case 'w': width = std::stoi(optarg); break;
+            case 'h': height = std::stoi(optarg); break;
+            // group allowed to read the ring
+            case 'g': groupName = optarg; break;
+            // invalid argument
+            case '?': PRINT << "invalid argument, valid options: -a [addr], -p [port], -k [keydir], -n [name], -s [slots], -b [slot bytes], -e [event slots], -w [width], -h [height], -g [group]"; break;
+            default: break;
+            }
+        }
+        catch (std::exception&)
+        {
+            ERROR << "invalid value for option -" << static_cast<char>(o);
+            return CUS_FAILURE;
+        }
+    }
+
+    if (!ipAddr.size())
+    {
+        ERROR << "no ip address provided. run with '-a [addr]" << std::endl;
+        return CUS_FAILURE;
+    }
+
+    if (!port)
+    {
+        ERROR << "no casting port provided. run with '-p [port]" << std::endl;
+        return CUS_FAILURE;
+    }
+
+    if (slots < 2 || eventSlots < 2)
+    {
+        ERROR << "each ring needs at least 2 slots" << std::endl;
+        return CUS_FAILURE;
+    }
+
+    // default to an uncompressed 32 bit frame of the output size, which is the largest processed image the scanner sends
+    if (!slotSize)
+        slotSize = sizeof(relay::Slot) + static_cast<uint64_t>(width) * height * 4;
+
+    // the stream carries patient images, so only the current user reads it unless a group is given
+    int group = -1;
+    if (groupName.size())
+    {
+        const struct group* gr = getgrnam(groupName.c_str());
+        if (!gr)
+        {
+            ERROR << "unknown group " << groupName << std::endl;
+            return CUS_FAILURE;
+        }
+        group = static_cast<int>(gr->gr_gid);
+    }
+
+    if (!createRing(name, slots, slotSize, eventSlots, group))
+    {
+        ERROR << "could not create shared memory " << objName_ << ": " << strerror(errno) << std::endl;
+        return CUS_FAILURE;
+    }
+
+    PRINT << "relay " << objName_ << ": " << frames_.slots_ << " frame slots of " << frames_.slotSize_ << " bytes, "
+          << events_.slots_ << " event slots of " << events_.slotSize_ << " bytes";
+    PRINT << "starting caster...";
+
+    auto initParams = castDefaultInitParams();
+    initParams.args.argc = argc;
+    initParams.args.argv = argv;
+    initParams.storeDir = keydir.c_str();
+    initParams.newProcessedImageFn = newProcessedImageFn;
+    initParams.newRawImageFn = newRawImageFn;
+    initParams.newSpectralImageFn = newSpectralImageFn;
+    initParams.newImuDataFn = newImuDataFn;
+    initParams.freezeFn = freezeFn;
+    initParams.buttonFn = buttonFn;
+    initParams.errorFn = errorFn;
+    initParams.width = width;
+    initParams.height = height;
+    // initialize with callbacks
+    if (castInit(&initParams) < 0)
+    {
+        ERROR << "could not initialize caster" << std::endl;
+        return CUS_FAILURE;
+    }
+    if (castConnect(ipAddr.c_str(), port, "research", [](int imagePort, int imuPort, int swRevMatch)
+    {
+        if (imagePort == CUS_FAILURE)
+        {
+            ERROR << "could not connect to scanner" << std::endl;
+            quit_ = true;
+        }
+        else
+        {
+            PRINT << "...connected, streaming port: " << imagePort << ", imu port: " << imuPort;
+            if (swRevMatch == CUS_FAILURE)
+                ERROR << "software revisions do not match, that is not necessarily a problem" << std::endl;
+        }
+        publish(relay::Type::State, [imagePort](relay::Slot* s)
+        {
+            s->value_[0] = (imagePort == CUS_FAILURE) ? 0 : 1;
+            s->value_[1] = imagePort;
+        }, nullptr, 0);
+    }) < 0)
+    {
+        ERROR << "connection attempt failed" << std::endl;
+        return CUS_FAILURE;
+    }
+
+    return 0;
+}
+
+/// main entry point
+/// @param[in] argc # of program arguments
+/// @param[in] argv list of arguments
+int main(int argc, char* argv[])
+{
+    setvbuf(stdout, nullptr, _IONBF, 0) != 0 || setvbuf(stderr, nullptr, _IONBF, 0);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    int rcode = init(argc, argv);
+
+    if (rcode == CUS_SUCCESS)
+    {
+        uint64_t last = 0, lastEvent = 0;
+        while (!quit_)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            const uint64_t head = ring_->head_.load(std::memory_order_relaxed);
+            const uint64_t eventHead = ring_->eventHead_.load(std::memory_order_relaxed);
+            std::cout << "\r" << "images/s: " << (head - last) << ", events/s: " << (eventHead - lastEvent) << ", oversize: " << ring_->oversize_.load(std::memory_order_relaxed)
+                      << ", waiting readers: " << ring_->waiters_.load(std::memory_order_relaxed) << "   " << std::flush;
+            last = head;
+            lastEvent = eventHead;
+        }
+        PRINT << "shutting down relay";
+    }
+
+    castDestroy();
+    destroyRing();
+    return rcode;
+}
@@ -0,0 +1,44 @@
+#include "relay.h"
+
+#include <climits>
+#include <cstdio>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    /// issues a futex call on the shared futex word, which lives in memory mapped by several processes, so the private
+    /// variants of the operations cannot be used
+    long futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const timespec* timeout)
+    {
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, timeout, nullptr, 0);
+    }
+}
+
+void relay::objectName(const char* name, char* out, size_t sz)
+{
+    snprintf(out, sz, "/cast_relay_%s", name);
+}
+
+void relay::wake(Header* hdr)
+{
+    hdr->futex_.fetch_add(1, std::memory_order_release);
+    // skip the system call when nobody is blocked, which is the common case for readers that keep up
+    if (hdr->waiters_.load(std::memory_order_seq_cst) > 0)
+        futex(&hdr->futex_, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+void relay::wait(Header* hdr, uint32_t value, int timeoutMs)
+{
+    timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+
+    hdr->waiters_.fetch_add(1, std::memory_order_seq_cst);
+    // returns immediately if the futex changed since the value was observed
+    futex(&hdr->futex_, FUTEX_WAIT, value, timeoutMs < 0 ? nullptr : &ts);
+    hdr->waiters_.fetch_sub(1, std::memory_order_seq_cst);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cast/cast_def.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// shared memory layout of the cast relay
+/// @details the relay daemon holds the only cast session and writes every callback into rings of fixed size slots in a
+///          posix shared memory object named /cast_relay_<name>. images go to a ring of frame sized slots, streamed imu
+///          samples and events to a second ring of small slots, so a fast imu stream does not push images out of the
+///          ring before slow readers get to them. slots are written in sequence and overwritten once
+///          the ring wraps, the daemon never waits for readers. each slot is guarded by a sequence counter that is odd
+///          while the slot is written and equals 2 * (message index + 1) once complete, so readers can access the data
+///          in place and detect afterwards whether it was overwritten while in use. readers block on a futex word that
+///          the daemon increments after each message. the object is only accessible to the user running the daemon, or
+///          to a group chosen when it starts. the ring geometry is published in the header for readers to validate once,
+///          the daemon and each reader then keep their own copy, so a process rewriting the header cannot move any access
+///          outside of the mapping
+namespace relay
+{
+    const uint32_t kMagic = 0x43524c59;     ///< 'CRLY'
+    const uint32_t kVersion = 2;
+    const int kMaxPos = 32;                 ///< maximum # of imu samples stored with a frame
+    const int kMaxText = 256;               ///< maximum length of error messages
+    const size_t kAlign = 64;               ///< alignment of slots and their data
+
+    /// message types
+    enum class Type : uint32_t
+    {
+        None,
+        Processed,  ///< processed image, info in processed_
+        Raw,        ///< raw (pre-scan converted or rf) image, info in raw_
+        Spectral,   ///< spectral image, info in spectral_
+        Imu,        ///< streamed imu sample, in pos_[0]
+        Freeze,     ///< freeze state change, in value_[0]
+        Button,     ///< button press, button in value_[0], clicks in value_[1]
+        Error,      ///< error message, text in the data
+        State,      ///< connection state change, connected in value_[0], image port in value_[1]
+    };
+
+    /// header of a slot, followed by the data
+    struct alignas(kAlign) Slot
+    {
+        std::atomic<uint64_t> seq_;     ///< sequence counter
+        Type type_;                     ///< message type
+        uint32_t size_;                 ///< size of the data in bytes
+        int32_t npos_;                  ///< # of imu samples in pos_
+        int32_t value_[2];              ///< event values
+        union
+        {
+            CusProcessedImageInfo processed_;
+            CusRawImageInfo raw_;
+            CusSpectralImageInfo spectral_;
+        };
+        CusPosInfo pos_[kMaxPos];       ///< imu samples
+
+        /// retrieves the data following the header
+        /// @return the data
+        const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(this) + sizeof(Slot); }
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this) + sizeof(Slot); }
+    };
+
+    /// checks which ring a message type is published in
+    /// @param[in] type the message type
+    /// @return true for images, which use the frame ring, false for imu samples and events
+    inline bool isFrame(Type type) { return type == Type::Processed || type == Type::Raw || type == Type::Spectral; }
+
+    /// header of the shared memory object, followed by the frame ring and then the event ring
+    struct alignas(kAlign) Header
+    {
+        uint32_t magic_;                ///< identifies a relay
+        uint32_t version_;              ///< layout version
+        uint32_t slots_;                ///< # of slots in the frame ring
+        uint32_t pid_;                  ///< process id of the daemon
+        uint64_t slotSize_;             ///< size of each frame slot including its header
+        uint32_t eventSlots_;           ///< # of slots in the event ring
+        uint32_t reserved_;             ///< unused
+        uint64_t eventSlotSize_;        ///< size of each event slot including its header
+        std::atomic<uint64_t> head_;    ///< # of frame messages published
+        std::atomic<uint64_t> eventHead_;   ///< # of event messages published
+        std::atomic<uint64_t> oversize_;    ///< # of messages that did not fit in a slot
+        alignas(kAlign) std::atomic<uint32_t> futex_;   ///< incremented after each message of either ring
+        std::atomic<uint32_t> waiters_; ///< # of readers blocked on the futex
+        std::atomic<uint32_t> alive_;   ///< cleared when the daemon exits
+    };
+
+    /// geometry of one ring, the daemon and each reader keep their own copy
+    struct Ring
+    {
+        size_t offset_;     ///< offset of the first slot from the start of the shared memory
+        uint32_t slots_;    ///< # of slots
+        uint64_t slotSize_; ///< size of each slot including its header
+
+        /// @return the size of the ring in bytes
+        size_t size() const { return static_cast<size_t>(slots_) * slotSize_; }
+
+        /// retrieves a slot
+        /// @param[in] hdr the shared memory header
+        /// @param[in] index the message index
+        /// @return the slot the message is stored in
+        Slot* slot(Header* hdr, uint64_t index) const
+        {
+            return reinterpret_cast<Slot*>(reinterpret_cast<uint8_t*>(hdr) + offset_ + (index % slots_) * slotSize_);
+        }
+    };
+
+    /// calculates the total size of the shared memory object
+    /// @param[in] frames the frame ring
+    /// @param[in] events the event ring
+    /// @return the size in bytes
+    inline size_t totalSize(const Ring& frames, const Ring& events) { return sizeof(Header) + frames.size() + events.size(); }
+
+    /// builds the shared memory object name
+    /// @param[in] name the relay name
+    /// @param[out] out the object name
+    /// @param[in] sz size of the output buffer
+    void objectName(const char* name, char* out, size_t sz);
+
+    /// wakes readers blocked on the futex
+    /// @param[in] hdr the shared memory header
+    void wake(Header* hdr);
+
+    /// blocks until the futex changes
+    /// @param[in] hdr the shared memory header
+    /// @param[in] value the futex value observed before deciding to wait
+    /// @param[in] timeoutMs the maximum time to wait in milliseconds, negative to wait forever
+    void wait(Header* hdr, uint32_t value, int timeoutMs);
+}
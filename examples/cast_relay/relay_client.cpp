@@ -0,0 +1,168 @@
+#include "relay_client.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+
+/// default constructor
+RelayClient::RelayClient() : hdr_(nullptr), size_(0), frames_(), events_(), last_(nullptr)
+{
+}
+
+/// destructor
+RelayClient::~RelayClient()
+{
+    close();
+}
+
+/// maps the shared memory of a running relay
+/// @param[in] name the relay name
+/// @return success of the call
+/// @details reading starts at the latest message, messages published before the client connected are ignored
+bool RelayClient::open(const char* name)
+{
+    close();
+
+    char obj[128];
+    relay::objectName(name, obj, sizeof(obj));
+    // readers need write access for the futex word and the waiter count, the ring itself is never written
+    const int fd = shm_open(obj, O_RDWR, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(relay::Header)))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+
+    // the geometry is copied before it is validated, so it cannot change in between
+    auto hdr = static_cast<relay::Header*>(mem);
+    const uint64_t limit = static_cast<uint64_t>(st.st_size);
+    relay::Ring frames = { sizeof(relay::Header), hdr->slots_, hdr->slotSize_ };
+    relay::Ring events = { 0, hdr->eventSlots_, hdr->eventSlotSize_ };
+    auto fits = [limit](const relay::Ring& r) { return r.slots_ && r.slotSize_ >= sizeof(relay::Slot) && r.slotSize_ <= limit && r.slots_ <= limit / r.slotSize_; };
+    if (hdr->magic_ != relay::kMagic || hdr->version_ != relay::kVersion || !fits(frames) || !fits(events) ||
+        relay::totalSize(frames, events) > limit)
+    {
+        munmap(mem, st.st_size);
+        return false;
+    }
+    events.offset_ = frames.offset_ + frames.size();
+
+    hdr_ = hdr;
+    size_ = st.st_size;
+    frames_ = { frames, 0, 0, 0 };
+    frames_.cursor_ = frames_.current_ = hdr_->head_.load(std::memory_order_acquire);
+    events_ = { events, 0, 0, 0 };
+    events_.cursor_ = events_.current_ = hdr_->eventHead_.load(std::memory_order_acquire);
+    last_ = nullptr;
+    return true;
+}
+
+/// unmaps the shared memory
+void RelayClient::close()
+{
+    if (hdr_)
+        munmap(hdr_, size_);
+    hdr_ = nullptr;
+    size_ = 0;
+}
+
+/// checks if the daemon is still running
+/// @return the daemon state
+bool RelayClient::alive() const
+{
+    if (!hdr_ || !hdr_->alive_.load(std::memory_order_acquire))
+        return false;
+    // a daemon that was killed cannot clear the flag, so check the process as well
+    return kill(static_cast<pid_t>(hdr_->pid_), 0) == 0 || errno == EPERM;
+}
+
+/// retrieves the next message
+/// @param[in] timeoutMs the maximum time to wait for a message in milliseconds, negative to wait forever
+/// @return the message in the shared memory, or null if none arrived in time
+/// @details the message is not copied, the caller must check it with valid() after using the data to know whether the
+///          daemon overwrote it in the meantime. the message stays accessible until the daemon laps its ring
+const relay::Slot* RelayClient::next(int timeoutMs)
+{
+    if (!hdr_)
+        return nullptr;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        const uint32_t fx = hdr_->futex_.load(std::memory_order_acquire);
+        if (auto msg = take(events_, hdr_->eventHead_))
+            return msg;
+        if (auto msg = take(frames_, hdr_->head_))
+            return msg;
+
+        int remain = timeoutMs;
+        if (timeoutMs >= 0)
+        {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= timeoutMs)
+                return nullptr;
+            remain = static_cast<int>(timeoutMs - elapsed);
+        }
+        relay::wait(hdr_, fx, remain);
+    }
+}
+
+/// retrieves the next message of one ring without waiting
+/// @param[in,out] rd the position in the ring
+/// @param[in] head the # of messages published to the ring
+/// @return the message in the shared memory, or null if there is no new message
+const relay::Slot* RelayClient::take(Reader& rd, const std::atomic<uint64_t>& head)
+{
+    for (;;)
+    {
+        const uint64_t published = head.load(std::memory_order_acquire);
+        if (rd.cursor_ >= published)
+            return nullptr;
+
+        // too far behind, the oldest slots are being overwritten, so skip to the oldest one that is safe to read
+        if (published - rd.cursor_ >= rd.ring_.slots_)
+        {
+            const uint64_t oldest = published - rd.ring_.slots_ + 1;
+            rd.dropped_ += oldest - rd.cursor_;
+            rd.cursor_ = oldest;
+        }
+
+        const relay::Slot* msg = rd.ring_.slot(hdr_, rd.cursor_);
+        const uint64_t seq = msg->seq_.load(std::memory_order_acquire);
+        if (seq == 2 * (rd.cursor_ + 1) && msg->size_ <= rd.ring_.slotSize_ - sizeof(relay::Slot))
+        {
+            rd.current_ = rd.cursor_++;
+            last_ = &rd;
+            return msg;
+        }
+        // the slot has been taken by a newer message or is corrupt, retry with the updated head
+        if (seq >= 2 * (rd.cursor_ + 1))
+        {
+            rd.dropped_++;
+            rd.cursor_++;
+        }
+    }
+}
+
+/// checks that a message was not overwritten while in use
+/// @param[in] msg the message last returned by next()
+/// @return true if the data read from the message is intact
+bool RelayClient::valid(const relay::Slot* msg) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return msg && last_ && msg->seq_.load(std::memory_order_relaxed) == 2 * (last_->current_ + 1);
+}
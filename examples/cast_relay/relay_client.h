@@ -0,0 +1,46 @@
+#pragma once
+
+#include "relay.h"
+
+/// reads messages from a cast relay
+/// @details every client keeps its own position in each ring, so clients read at independent rates without affecting
+///          the daemon or each other. messages are accessed in place, a client that falls more than a ring behind
+///          skips ahead to the oldest intact message and counts the skipped messages as dropped. imu samples and events
+///          are returned ahead of images, their order relative to the images is not kept, images carry the imu samples
+///          of their own acquisition. the ring geometry is read once when opening, and messages claiming more data than
+///          a slot holds are skipped
+class RelayClient
+{
+public:
+    RelayClient();
+    ~RelayClient();
+
+    bool open(const char* name);
+    void close();
+    bool isOpen() const { return hdr_ != nullptr; }
+    bool alive() const;
+
+    const relay::Slot* next(int timeoutMs);
+    bool valid(const relay::Slot* msg) const;
+    uint64_t dropped() const { return frames_.dropped_ + events_.dropped_; }
+    uint64_t position() const { return frames_.cursor_; }
+
+private:
+    /// position of the client in one ring
+    struct Reader
+    {
+        relay::Ring ring_;      ///< geometry of the ring
+        uint64_t cursor_;       ///< index of the next message to read
+        uint64_t current_;      ///< index of the message last returned
+        uint64_t dropped_;      ///< # of messages skipped because they were overwritten
+    };
+
+    const relay::Slot* take(Reader& rd, const std::atomic<uint64_t>& head);
+
+private:
+    relay::Header* hdr_;    ///< mapped shared memory
+    size_t size_;           ///< size of the mapping
+    Reader frames_;         ///< position in the frame ring
+    Reader events_;         ///< position in the imu and event ring
+    const Reader* last_;    ///< ring of the message last returned
+};
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+#include <unistd.h>
+
+#include "relay_client.h"
+
+#define PRINT           std::cout << std::endl
+#define PRINTSL         std::cout << "\r"
+#define ERROR           std::cerr << std::endl
+
+/// example consumer of a cast relay that reports the message rates it sees
+/// @details the optional delay simulates a slow consumer, which only drops messages itself and does not affect the
+///          daemon or other consumers
+int main(int argc, char* argv[])
+{
+    std::string name = "default";
+    int delay = 0;
+    int o;
+
+    while ((o = getopt(argc, argv, "n:d:")) != -1)
+    {
+        switch (o)
+        {
+        // relay name
+        case 'n': name = optarg; break;
+        // processing delay per image in milliseconds
+        case 'd':
+            try { delay = std::stoi(optarg); }
+            catch (std::exception&) { delay = 0; }
+            break;
+        case '?': PRINT << "invalid argument, valid options: -n [name], -d [delay ms]"; break;
+        default: break;
+        }
+    }
+
+    RelayClient client;
+    if (!client.open(name.c_str()))
+    {
+        ERROR << "could not open relay '" << name << "', check that the daemon is running" << std::endl;
+        return -1;
+    }
+
+    uint64_t images = 0, imu = 0, torn = 0;
+    auto last = std::chrono::steady_clock::now();
+
+    while (client.alive())
+    {
+        const relay::Slot* msg = client.next(500);
+        if (msg)
+        {
+            switch (msg->type_)
+            {
+            case relay::Type::Processed:
+            case relay::Type::Raw:
+            case relay::Type::Spectral:
+            {
+                // touch the data in place, then confirm it was not overwritten while reading
+                uint32_t sum = 0;
+                for (uint32_t i = 0; i < msg->size_; i += 64)
+                    sum += msg->data()[i];
+                (void)sum;
+                if (delay)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                if (client.valid(msg))
+                    images++;
+                else
+                    torn++;
+                break;
+            }
+            case relay::Type::Imu: imu++; break;
+            case relay::Type::Freeze: PRINT << (msg->value_[0] ? "frozen" : "imaging"); break;
+            case relay::Type::Button: PRINT << "button " << msg->value_[0] << ", clicks: " << msg->value_[1]; break;
+            case relay::Type::Error: ERROR << "error: " << std::string(reinterpret_cast<const char*>(msg->data()), msg->size_); break;
+            case relay::Type::State: PRINT << (msg->value_[0] ? "connected" : "connection failed"); break;
+            default: break;
+            }
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last >= std::chrono::seconds(1))
+        {
+            PRINTSL << "images/s: " << images << ", imu/s: " << imu << ", dropped: " << client.dropped() << ", overwritten while read: " << torn
+                    << "   " << std::flush;
+            images = imu = 0;
+            last = now;
+        }
+    }
+
+    PRINT << "relay stopped" << std::endl;
+    return 0;
+}
@@ -6,4 +6,5 @@ LIBPATH = $$PWD/../../lib
 INCLUDEPATH += $$PWD/../../include
 LIBS += -L$$LIBPATH/ -lcast
 
-SOURCES += main.cpp
+SOURCES += main.cpp transaction.cpp udp.cpp
+HEADERS += transaction.h udp.h
@@ -13,6 +13,8 @@
 #endif
 
 #include <cast/cast.h>
+#include "transaction.h"
+#include "udp.h"
 
 #define PRINT           std::cout << std::endl
 #define PRINTSL         std::cout << "\r"
@@ -24,6 +26,10 @@ static int counter_ = 0;
 static bool streamOutput_ = true;
 static long long int lasttime_ = 0;
 static int captureID_ = -1;
+static int imagePort_ = 0;
+static int imuPort_ = 0;
+static udp::Tuning tuning_ = { 8 * 1024 * 1024, 0 };
+static ParameterTransaction transaction_;
 
 /// callback for error messages
 /// @param[in] err the error message sent from the casting module
@@ -111,9 +117,12 @@ void newProcessedImageFn(const void* newImage, const CusProcessedImageInfo* nfo,
 {
     (void)newImage;
     (void)pos;
+    // frames received while a parameter transaction is being applied may mix old and new settings
+    const bool settling = transaction_.settling(nfo->tm);
     if (streamOutput_)
         PRINTSL << "new image (" << counter_++ << "): " << nfo->width << " x " << nfo->height << " @ " << nfo->bitsPerPixel << " bpp. @ "
-                << nfo->imageSize << "bytes. @ " << nfo->micronsPerPixel << " microns per pixel. imu points: " << npos << std::flush;
+                << nfo->imageSize << "bytes. @ " << nfo->micronsPerPixel << " microns per pixel. imu points: " << npos
+                << (settling ? " (settling)" : "") << std::flush;
 }
 
 /// callback for a new spectral image sent from the scanner
@@ -160,6 +169,51 @@ bool saveRawData()
     return true;
 }
 
+/// enlarges the receive buffer of a streaming socket, so bursts of large frames are not dropped by the kernel, and
+/// enables busy polling on it, each only when requested
+/// @param[in] port the local port of the socket
+/// @param[in] name the stream name
+void tuneSocket(int port, const char* name)
+{
+    if (port <= 0 || (tuning_.receiveBuffer <= 0 && tuning_.busyPoll <= 0))
+        return;
+    const int size = udp::tune(port, tuning_);
+    if (size < 0 || tuning_.receiveBuffer <= 0)
+        return;
+    PRINT << name << " receive buffer: " << size << "B";
+    // the kernel reports twice the usable size, and caps unprivileged requests at net.core.rmem_max
+    if (size < 2 * tuning_.receiveBuffer)
+        PRINT << "requested " << tuning_.receiveBuffer << "B, raise net.core.rmem_max (now " << udp::maxReceiveBuffer() << "B) or run with CAP_NET_ADMIN";
+}
+
+/// prints the kernel state of a streaming socket
+/// @param[in] port the local port of the socket
+/// @param[in] name the stream name
+void printSocket(int port, const char* name)
+{
+    udp::Stats st;
+    if (port <= 0 || !udp::stats(port, st))
+    {
+        PRINT << name << ": no socket information";
+        return;
+    }
+    PRINT << name << " port " << st.port << ": buffer " << st.receiveBuffer << "B, queued " << st.queued << "B, kernel drops: " << st.drops;
+}
+
+/// called when a parameter transaction completes
+/// @param[in] result the combined result of the changes
+/// @param[in] failed # of changes that failed
+/// @param[in] firstFrame timestamp of the first frame with the new settings, 0 if none arrived before the deadline
+void doneTransaction(int result, int failed, long long int firstFrame)
+{
+    if (result < 0)
+        ERROR << "parameter transaction failed, " << failed << " change(s) not applied";
+    else if (!firstFrame)
+        PRINT << "parameter transaction applied, no frames received since";
+    else
+        PRINT << "parameter transaction applied, first frame with the new settings: " << firstFrame;
+}
+
 void doneCapture(int result)
 {
     if (result < 0)
@@ -250,6 +304,11 @@ void processEventLoop(std::atomic_bool& quit)
         {
             streamOutput_ = !streamOutput_;
         }
+        else if (cmd == 'U' || cmd == 'u')
+        {
+            printSocket(imagePort_, "image");
+            printSocket(imuPort_, "imu");
+        }
         else if (cmd == 'R' || cmd == 'r')
         {
             if (castRequestRawData(0, 0, 1, [](int sz, const char*)
@@ -364,6 +423,50 @@ void processEventLoop(std::atomic_bool& quit)
                 PRINT << "added measurement '" << prms.back() << "' from (" << x1 << ", " << y1 << ") "
                     << "to (" << x2 << ", " << y2 << ") to capture" << std::endl;
         }
+        else if (cmd == 't' || cmd == 'T')
+        {
+            const std::vector<std::string> prms = getParameters(line, 64);
+            if (prms.empty() || !transaction_.begin())
+            {
+                ERROR << (prms.empty() ? "usage: t {param_name}={param_value} ..." : "a parameter transaction is still being applied") << std::endl;
+                continue;
+            }
+            bool valid = true;
+            for (const auto& p : prms)
+            {
+                const auto eq = p.find('=');
+                if (eq == std::string::npos || eq == 0)
+                {
+                    valid = false;
+                    break;
+                }
+                const std::string name = p.substr(0, eq);
+                const std::string value = p.substr(eq + 1);
+                std::string prm = name;
+                std::transform(prm.begin(), prm.end(), prm.begin(), ::tolower);
+                double val = 0;
+                if (value == "true" || value == "false")
+                    transaction_.enable(name, value == "true");
+                else if (prm.find("pulse") != std::string::npos)
+                    transaction_.pulse(name, value);
+                else if (parseDouble(val, value))
+                    transaction_.set(name, val);
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            if (!valid)
+            {
+                transaction_.cancel();
+                ERROR << "usage: t {param_name}={param_value} ..." << std::endl;
+            }
+            else if (transaction_.commit(&doneTransaction) < 0)
+                ERROR << "parameter transaction could not be issued" << std::endl;
+            else
+                PRINT << "applying " << transaction_.size() << " parameter changes";
+        }
         else if (cmd == 'p' || cmd == 'P')
         {
             const std::vector<std::string> prms = getParameters(line, 2);
@@ -419,7 +522,8 @@ void processEventLoop(std::atomic_bool& quit)
             PRINT << "valid commands: [q: quit]";
             PRINT << "       display: [s: toggle stream outptu]";
             PRINT << "       imaging: [f: freeze, d/D: depth, g/G: gain]";
-            PRINT << "        params: [p: change parameter]";
+            PRINT << "        params: [p: change parameter, t: change several parameters together]";
+            PRINT << "       network: [u: udp socket buffers and kernel drops]";
             PRINT << "      raw data: [r: request, y: download]";
             PRINT << "       capture: [c: start/end capture, l: add label, m: add measurement]" << std::endl;
         }
@@ -477,7 +581,7 @@ int init(int& argc, char** argv)
     keydir = "/tmp/";
 
     // check command line options
-    while ((o = getopt(argc, argv, "k:a:p:")) != -1)
+    while ((o = getopt(argc, argv, "k:a:p:r:b:")) != -1)
     {
         switch (o)
         {
@@ -490,8 +594,18 @@ int init(int& argc, char** argv)
             try { port = std::stoi(optarg); }
             catch (std::exception&) { PRINT << port; }
             break;
+        // socket receive buffer size in bytes, 0 to keep the system default
+        case 'r':
+            try { tuning_.receiveBuffer = std::stoi(optarg); }
+            catch (std::exception&) { PRINT << "invalid receive buffer size"; }
+            break;
+        // socket busy polling time in microseconds
+        case 'b':
+            try { tuning_.busyPoll = std::stoi(optarg); }
+            catch (std::exception&) { PRINT << "invalid busy polling time"; }
+            break;
         // invalid argument
-        case '?': PRINT << "invalid argument, valid options: -a [addr], -p [port], -k [keydir]"; break;
+        case '?': PRINT << "invalid argument, valid options: -a [addr], -p [port], -k [keydir], -r [receive buffer bytes], -b [busy poll us]"; break;
         default: break;
         }
     }
@@ -538,6 +652,10 @@ int init(int& argc, char** argv)
         else
         {
             PRINT << "...connected, streaming port: " << imagePort << " -- check firewall settings if no image callback received";
+            imagePort_ = imagePort;
+            imuPort_ = imuPort;
+            tuneSocket(imagePort, "image");
+            tuneSocket(imuPort, "imu");
             if (imuPort > 0)
             {
                 PRINT << "imu now streaming at port: " << imuPort;
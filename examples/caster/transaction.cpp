@@ -0,0 +1,167 @@
+#include "transaction.h"
+
+#include <cast/cast.h>
+#include <algorithm>
+
+/// the api return callbacks carry no context, so the transaction in flight is tracked here, it is set from the console
+/// and cleared from whichever thread completes the transaction
+static std::atomic<ParameterTransaction*> _transaction(nullptr);
+/// time allowed for the changes to be acknowledged
+static const std::chrono::seconds _timeout(5);
+
+/// default constructor
+ParameterTransaction::ParameterTransaction() : open_(false), outstanding_(0), failed_(0), acknowledged_(false), inFlight_(false), fn_(nullptr)
+{
+}
+
+/// starts collecting changes
+/// @return false if a transaction is still in flight and its deadline has not passed
+bool ParameterTransaction::begin()
+{
+    if (inFlight_ && !expire())
+        return false;
+    changes_.clear();
+    open_ = true;
+    return true;
+}
+
+/// adds a numeric parameter change
+/// @param[in] prm the parameter name
+/// @param[in] val the new value
+void ParameterTransaction::set(const std::string& prm, double val)
+{
+    if (open_)
+        changes_.push_back({ Change::Type::Value, prm, val, std::string() });
+}
+
+/// adds a parameter enable or disable
+/// @param[in] prm the parameter name
+/// @param[in] en the enable flag
+void ParameterTransaction::enable(const std::string& prm, bool en)
+{
+    if (open_)
+        changes_.push_back({ Change::Type::Enable, prm, en ? 1.0 : 0.0, std::string() });
+}
+
+/// adds a pulse shape change
+/// @param[in] prm the parameter name
+/// @param[in] shape the pulse shape
+void ParameterTransaction::pulse(const std::string& prm, const std::string& shape)
+{
+    if (open_)
+        changes_.push_back({ Change::Type::Pulse, prm, 0, shape });
+}
+
+/// discards the collected changes
+void ParameterTransaction::cancel()
+{
+    changes_.clear();
+    open_ = false;
+}
+
+/// issues all collected changes
+/// @param[in] fn called once with the combined result
+/// @return 0 if the changes were issued, -1 if nothing was collected or a transaction is in flight
+/// @details changes the library rejects right away are counted as failed without waiting for an answer
+int ParameterTransaction::commit(ResultFn fn)
+{
+    if (!open_ || changes_.empty() || inFlight_)
+        return -1;
+
+    open_ = false;
+    fn_ = fn;
+    failed_ = 0;
+    acknowledged_ = false;
+    // one extra count holds completion back until every request has been issued
+    outstanding_ = static_cast<int>(changes_.size()) + 1;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        deadline_ = std::chrono::steady_clock::now() + _timeout;
+        inFlight_ = true;
+    }
+    _transaction = this;
+
+    for (const auto& c : changes_)
+    {
+        int ret = -1;
+        switch (c.type_)
+        {
+        case Change::Type::Value: ret = castSetParameter(c.prm_.c_str(), c.val_, &ParameterTransaction::onReturn); break;
+        case Change::Type::Enable: ret = castEnableParameter(c.prm_.c_str(), c.val_ != 0 ? 1 : 0, &ParameterTransaction::onReturn); break;
+        case Change::Type::Pulse: ret = castSetPulse(c.prm_.c_str(), c.shape_.c_str(), &ParameterTransaction::onReturn); break;
+        }
+        if (ret < 0)
+            onReturn(CUS_FAILURE);
+    }
+    onReturn(CUS_SUCCESS);
+    return 0;
+}
+
+/// accounts for an answer to one of the changes
+/// @param[in] ret the result of the change
+void ParameterTransaction::onReturn(int ret)
+{
+    ParameterTransaction* t = _transaction;
+    if (!t)
+        return;
+    if (ret == CUS_FAILURE)
+        t->failed_++;
+    if (--t->outstanding_ == 0)
+    {
+        // nothing applied means no frame will show new settings, so there is nothing to wait for
+        std::lock_guard<std::mutex> lock(t->lock_);
+        if (!t->inFlight_)
+            return;
+        if (t->failed_ >= static_cast<int>(t->changes_.size()))
+        {
+            t->inFlight_ = false;
+            _transaction = nullptr;
+            if (t->fn_)
+                t->fn_(CUS_FAILURE, t->failed_, 0);
+        }
+        else
+            t->acknowledged_ = true;
+    }
+}
+
+/// checks a received frame against the transaction in flight
+/// @param[in] tm the frame timestamp
+/// @return true if the frame may show partially applied settings and should not be used
+/// @details the first frame received after every change was acknowledged completes the transaction
+bool ParameterTransaction::settling(long long int tm)
+{
+    if (!inFlight_)
+        return false;
+    if (!acknowledged_)
+        return !expire();
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!inFlight_)
+        return false;
+    inFlight_ = false;
+    _transaction = nullptr;
+    if (fn_)
+        fn_(failed_ ? CUS_FAILURE : CUS_SUCCESS, failed_, tm);
+    return false;
+}
+
+/// completes the transaction in flight if its deadline passed, changes not acknowledged by then count as failed
+/// @return true if the transaction is no longer in flight
+/// @details answers arriving after the deadline are ignored, unless a new transaction is in flight by then, as the
+///          return callbacks cannot tell the two apart
+bool ParameterTransaction::expire()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!inFlight_)
+        return true;
+    if (std::chrono::steady_clock::now() < deadline_)
+        return false;
+    inFlight_ = false;
+    _transaction = nullptr;
+    // acknowledged changes applied even if no frame showed them, such as while frozen
+    if (!acknowledged_)
+        failed_ += std::max(outstanding_.load(), 0);
+    if (fn_)
+        fn_(failed_ ? CUS_FAILURE : CUS_SUCCESS, failed_, 0);
+    return true;
+}
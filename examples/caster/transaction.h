@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// groups parameter changes so they are applied together
+/// @details changes are collected between begin() and commit(), then all requests are issued back to back without
+///          waiting for each answer, so a preset switch costs about one round trip instead of one per parameter.
+///          frames received until every change is acknowledged may show a mix of old and new settings and are reported
+///          as settling, the result is delivered once with the timestamp of the first frame received after the last
+///          acknowledgement. only one transaction can be in flight, as the api callbacks do not identify the request.
+///          a transaction still in flight at its deadline, such as after losing the connection or while frozen, completes
+///          with the next frame or the next begin(), changes not acknowledged by then count as failed
+class ParameterTransaction
+{
+public:
+    /// called when the transaction completes
+    /// @param[in] result 0 if every change succeeded, -1 otherwise
+    /// @param[in] failed # of changes that failed
+    /// @param[in] firstFrame timestamp of the first frame with the new settings, 0 if none arrived yet or the deadline passed
+    typedef void (*ResultFn)(int result, int failed, long long int firstFrame);
+
+    ParameterTransaction();
+
+    bool begin();
+    void set(const std::string& prm, double val);
+    void enable(const std::string& prm, bool en);
+    void pulse(const std::string& prm, const std::string& shape);
+    int commit(ResultFn fn);
+    void cancel();
+    bool settling(long long int tm);
+    size_t size() const { return changes_.size(); }
+    bool open() const { return open_; }
+
+private:
+    /// a single parameter change
+    struct Change
+    {
+        enum class Type { Value, Enable, Pulse } type_;
+        std::string prm_;   ///< parameter name
+        double val_;        ///< value or enable flag
+        std::string shape_; ///< pulse shape
+    };
+
+    static void onReturn(int ret);
+    bool expire();
+
+private:
+    std::vector<Change> changes_;   ///< changes collected since begin()
+    bool open_;                     ///< flag that changes are being collected
+    std::atomic_int outstanding_;   ///< # of changes not yet acknowledged
+    std::atomic_int failed_;        ///< # of changes that failed
+    std::atomic_bool acknowledged_; ///< flag that every change was acknowledged, waiting for a frame
+    std::atomic_bool inFlight_;     ///< flag that a committed transaction has not completed
+    ResultFn fn_;                   ///< result callback
+    std::chrono::steady_clock::time_point deadline_;    ///< time by which every change should be acknowledged
+    std::mutex lock_;               ///< serializes completion between the return and frame callbacks, guards the deadline
+};
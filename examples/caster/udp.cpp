@@ -0,0 +1,179 @@
+#include "udp.h"
+
+#ifdef __linux__
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    /// looks up the socket bound to a local udp port
+    /// @param[in] port the local port
+    /// @param[out] inode the socket inode
+    /// @param[out] queued bytes waiting to be read
+    /// @param[out] drops datagrams dropped by the kernel
+    /// @return success of the call
+    bool findSocket(int port, unsigned long& inode, unsigned long& queued, unsigned long& drops)
+    {
+        const char* tables[] = { "/proc/net/udp", "/proc/net/udp6" };
+        for (auto table : tables)
+        {
+            FILE* fp = fopen(table, "r");
+            if (!fp)
+                continue;
+
+            char line[512];
+            // skip the column titles
+            if (!fgets(line, sizeof(line), fp))
+            {
+                fclose(fp);
+                continue;
+            }
+            while (fgets(line, sizeof(line), fp))
+            {
+                // sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode ref pointer drops
+                char local[64];
+                unsigned long txq = 0, rxq = 0, ino = 0, dr = 0;
+                if (sscanf(line, " %*d: %63s %*s %*x %lx:%lx %*x:%*x %*x %*u %*u %lu %*d %*s %lu", local, &txq, &rxq, &ino, &dr) != 5)
+                    continue;
+                const char* colon = strrchr(local, ':');
+                if (!colon || strtol(colon + 1, nullptr, 16) != port)
+                    continue;
+                inode = ino;
+                queued = rxq;
+                drops = dr;
+                fclose(fp);
+                return true;
+            }
+            fclose(fp);
+        }
+        return false;
+    }
+
+    /// finds the file descriptor of a socket in this process
+    /// @param[in] inode the socket inode
+    /// @return the file descriptor, -1 if the socket does not belong to this process
+    int findDescriptor(unsigned long inode)
+    {
+        DIR* dir = opendir("/proc/self/fd");
+        if (!dir)
+            return -1;
+
+        char expected[64];
+        snprintf(expected, sizeof(expected), "socket:[%lu]", inode);
+        int fd = -1;
+        while (struct dirent* e = readdir(dir))
+        {
+            char path[300], link[64];
+            snprintf(path, sizeof(path), "/proc/self/fd/%s", e->d_name);
+            const ssize_t n = readlink(path, link, sizeof(link) - 1);
+            if (n <= 0)
+                continue;
+            link[n] = '\0';
+            if (strcmp(link, expected) == 0)
+            {
+                fd = atoi(e->d_name);
+                break;
+            }
+        }
+        closedir(dir);
+        return fd;
+    }
+
+    /// locates the socket bound to a local port in this process
+    /// @param[in] port the local port
+    /// @return the file descriptor, -1 if not found
+    int socketOf(int port)
+    {
+        unsigned long inode = 0, queued = 0, drops = 0;
+        return findSocket(port, inode, queued, drops) ? findDescriptor(inode) : -1;
+    }
+}
+
+/// applies socket options to the socket receiving on a port
+/// @param[in] port the local port, as reported when connecting
+/// @param[in] tuning the options to apply
+/// @return the effective receive buffer size in bytes, -1 if the socket was not found
+/// @details buffers above the system limit (net.core.rmem_max) are forced when the process has the privilege to,
+///          otherwise the kernel caps them at the limit
+int udp::tune(int port, const Tuning& tuning)
+{
+    const int fd = socketOf(port);
+    if (fd < 0)
+        return -1;
+
+    if (tuning.receiveBuffer > 0)
+    {
+#ifdef SO_RCVBUFFORCE
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &tuning.receiveBuffer, sizeof(tuning.receiveBuffer)) < 0)
+#endif
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &tuning.receiveBuffer, sizeof(tuning.receiveBuffer));
+    }
+#ifdef SO_BUSY_POLL
+    if (tuning.busyPoll > 0)
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &tuning.busyPoll, sizeof(tuning.busyPoll));
+#endif
+
+    int size = 0;
+    socklen_t len = sizeof(size);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0)
+        return -1;
+    return size;
+}
+
+/// retrieves the kernel state of the socket receiving on a port
+/// @param[in] port the local port
+/// @param[out] st the socket state
+/// @return success of the call
+bool udp::stats(int port, Stats& st)
+{
+    unsigned long inode = 0;
+    st = Stats{ port, 0, 0, 0 };
+    if (!findSocket(port, inode, st.queued, st.drops))
+        return false;
+
+    const int fd = findDescriptor(inode);
+    if (fd >= 0)
+    {
+        socklen_t len = sizeof(st.receiveBuffer);
+        getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &st.receiveBuffer, &len);
+    }
+    return true;
+}
+
+/// retrieves the largest receive buffer an unprivileged process can request
+/// @return the limit in bytes, 0 if unknown
+int udp::maxReceiveBuffer()
+{
+    FILE* fp = fopen("/proc/sys/net/core/rmem_max", "r");
+    if (!fp)
+        return 0;
+    int size = 0;
+    if (fscanf(fp, "%d", &size) != 1)
+        size = 0;
+    fclose(fp);
+    return size;
+}
+
+#else
+
+int udp::tune(int, const Tuning&)
+{
+    return -1;
+}
+
+bool udp::stats(int, Stats&)
+{
+    return false;
+}
+
+int udp::maxReceiveBuffer()
+{
+    return 0;
+}
+
+#endif
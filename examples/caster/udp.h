@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+/// tuning and diagnostics of the udp sockets the cast library receives on
+/// @details the library creates its sockets with the system defaults, which on linux allow only a few hundred kilobytes
+///          of queued data, less than a handful of uncompressed full size frames. the sockets belong to this process, so
+///          once the ports are known they can be located through /proc and their receive buffers enlarged, and the
+///          kernel drop counters read back to tell socket overflows apart from losses on the link. on other platforms
+///          the functions do nothing
+namespace udp
+{
+    /// socket options to apply
+    struct Tuning
+    {
+        int receiveBuffer;  ///< receive buffer size in bytes, 0 to keep the default
+        int busyPoll;       ///< busy polling time in microseconds, 0 to disable
+    };
+
+    /// state of a socket as reported by the kernel
+    struct Stats
+    {
+        int port;               ///< local port
+        int receiveBuffer;      ///< effective receive buffer size in bytes
+        unsigned long queued;   ///< bytes waiting to be read
+        unsigned long drops;    ///< datagrams dropped because the buffer was full
+    };
+
+    int tune(int port, const Tuning& tuning);
+    bool stats(int port, Stats& st);
+    int maxReceiveBuffer();
+}
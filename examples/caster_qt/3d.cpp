@@ -3,11 +3,19 @@
 using namespace Qt3DCore;
 using namespace Qt3DRender;
 using namespace Qt3DExtras;
+using namespace Qt3DLogic;
 
 #define DEFAULT_VIEW    0.5, 0.5, -0.5, 0.5
 
+namespace
+{
+    /// longest time a sample is extrapolated for, protects against drift when the imu stream stops
+    const double kMaxPrediction = 0.1;
+}
+
 /// default constructor
-ProbeRender::ProbeRender(QScreen* sc) : Qt3DWindow(sc), orientation_(QQuaternion(DEFAULT_VIEW))
+ProbeRender::ProbeRender(QScreen* sc) : Qt3DWindow(sc), orientation_(QQuaternion(DEFAULT_VIEW)), received_(Clock::now()),
+    dirty_(true), prediction_(0), probeEntity_(nullptr), probe_(nullptr), frame_(nullptr)
 {
 }
 
@@ -35,28 +43,72 @@ QEntity* ProbeRender::createScene(const QString& model)
     probe_ = new QSceneLoader(probeEntity_);
     probe_->setSource(QUrl::fromLocalFile(model));
     probeEntity_->addComponent(probe_);
-    addTransform();
+    // the transform is attached once, only its rotation changes afterwards
+    transform_.setScale3D(QVector3D(100, 100, 100));
+    probeEntity_->addComponent(&transform_);
+    frame_ = new QFrameAction(root);
+    root->addComponent(frame_);
+    connect(frame_, &QFrameAction::triggered, this, &ProbeRender::onFrame);
+    onFrame(0);
     return root;
 }
 
-/// adds a new transform based on the latest orientation
-void ProbeRender::addTransform()
+/// applies the latest orientation to the model, called once per rendered frame
+/// @param[in] dt time since the last frame in seconds
+void ProbeRender::onFrame(float dt)
 {
-    transform_.setScale3D(QVector3D(100, 100, 100));
+    Q_UNUSED(dt)
+    const double prediction = prediction_;
+    // without prediction nothing changes between samples, with it the model keeps moving until the horizon is reached
+    if (!dirty_.exchange(false) && prediction <= 0)
+        return;
+
+    QQuaternion orientation;
+    QVector3D gyro;
+    Clock::time_point received;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        orientation = orientation_;
+        gyro = gyro_;
+        received = received_;
+    }
+
+    // extrapolate with the angular velocity to hide the transport latency, the rates are in the probe frame
+    if (prediction > 0 && !gyro.isNull())
+    {
+        const double age = std::chrono::duration<double>(Clock::now() - received).count();
+        const double t = std::min(prediction + age, kMaxPrediction);
+        const float rate = gyro.length();
+        orientation = orientation * QQuaternion::fromAxisAndAngle(gyro / rate, static_cast<float>(qRadiansToDegrees(rate * t)));
+    }
+
     QQuaternion axisCorrection(QQuaternion::fromEulerAngles(0, 180, 90));
     QQuaternion modelCorrection(QQuaternion::fromEulerAngles(-90, 0, 90));
-    auto modelRotation = orientation_ * axisCorrection;
+    auto modelRotation = orientation * axisCorrection;
     auto correctedOrientation = modelCorrection * modelRotation;
     transform_.setRotation(correctedOrientation);
-    probeEntity_->addComponent(&transform_);
 }
 
-/// updates the latest orientation
+/// updates the latest orientation, can be called from any thread
 /// @param[in] imu the latest imu data
-void ProbeRender::update(const QQuaternion& imu)
+/// @param[in] gyro the angular velocity at the time of the sample in radians per second, null disables prediction
+void ProbeRender::update(const QQuaternion& imu, const QVector3D& gyro)
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        orientation_ = imu;
+        gyro_ = gyro;
+        received_ = Clock::now();
+    }
+    dirty_ = true;
+}
+
+/// sets how far ahead the orientation is predicted
+/// @param[in] ms the expected latency of the imu stream in milliseconds, 0 to disable prediction
+void ProbeRender::setPrediction(double ms)
 {
-    orientation_ = imu;
-    addTransform();
+    prediction_ = std::max(ms, 0.0) / 1000.0;
+    dirty_ = true;
 }
 
 /// resets the view
@@ -1,6 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#define IMU_LATENCY     30  ///< typical latency of the imu stream in milliseconds, used for prediction
+#define IMU_TIMEOUT     500 ///< time without streamed imu samples in milliseconds before frame tagged orientations are shown again
+
 /// probe rendering output
+/// @details orientation updates only replace the latest sample, which is applied to the model once per rendered frame,
+///          so imu data arriving faster than the display refreshes does not cause any additional scene updates
 class ProbeRender : public Qt3DExtras::Qt3DWindow
 {
     Q_OBJECT
@@ -8,15 +17,24 @@ public:
     explicit ProbeRender(QScreen* sc);
     bool init(const QString& model);
     void reset();
-    void update(const QQuaternion& imu);
+    void update(const QQuaternion& imu, const QVector3D& gyro = QVector3D());
+    void setPrediction(double ms);
 
 private:
     Qt3DCore::QEntity* createScene(const QString& model);
-    void addTransform();
+    void onFrame(float dt);
 
 private:
-    QQuaternion orientation_;           ///< current orientation
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex lock_;                   ///< guards the latest sample
+    QQuaternion orientation_;           ///< latest orientation
+    QVector3D gyro_;                    ///< latest angular velocity in radians per second, in the probe frame
+    Clock::time_point received_;        ///< time the latest sample was received
+    std::atomic<bool> dirty_;           ///< flag that a new sample has not been applied yet
+    std::atomic<double> prediction_;    ///< time in seconds to predict ahead, 0 to disable
     Qt3DCore::QTransform transform_;    ///< transform matrix
     Qt3DCore::QEntity* probeEntity_;    ///< probe model node
     Qt3DRender::QSceneLoader* probe_;   ///< probe model scene
+    Qt3DLogic::QFrameAction* frame_;    ///< triggered once per rendered frame
 };
@@ -1,14 +1,27 @@
 #include "caster.h"
+#include "cine.h"
 #include "display.h"
+#include "format.h"
 #include "3d.h"
+#include "compositor.h"
+#include "imu.h"
+#include "motion.h"
+#include "reconnect.h"
+#include "resolution.h"
+#include "tiles.h"
+#include "tgc.h"
+#include "volume.h"
 #include "ui_caster.h"
 #include <cast/cast.h>
+#include <tuple>
 
 static Caster* _me;
 
 /// default constructor
 /// @param[in] parent the parent object
-Caster::Caster(QWidget *parent) : QMainWindow(parent), connected_(false), frozen_(false), lasttime_(0), imuSamples_(0), ui_(new Ui::Caster)
+Caster::Caster(QWidget *parent) : QMainWindow(parent), connected_(false), frozen_(false), lasttime_(0), imuSamples_(0), ui_(new Ui::Caster),
+    images_(IMAGE_EVENT), overlays_(IMAGE_EVENT), prescanImages_(PRESCAN_EVENT), rfData_(RF_EVENT), skipped_(nullptr), lastStats_(),
+    link_(nullptr), volumeFrames_(0), motionPendingTm_(0), motionBusy_(false), motionReset_(false)
 {
     _me = this;
     ui_->setupUi(this);
@@ -17,7 +30,149 @@ Caster::Caster(QWidget *parent) : QMainWindow(parent), connected_(false), frozen
     signal_ = new RfSignal(this);
     ui_->image->addWidget(image_);
     ui_->image->addWidget(signal_);
+    tiles_ = new TiledView(this);
+    tiles_->setVisible(false);
+    ui_->image->addWidget(tiles_);
     imageTimer_.setSingleShot(true);
+    skipped_ = new QLabel(this);
+    ui_->status->addPermanentWidget(skipped_);
+    link_ = new QLabel(this);
+    ui_->status->addPermanentWidget(link_);
+    connect(&statsTimer_, &QTimer::timeout, this, &Caster::updateStats);
+    statsTimer_.start(1000);
+    imu_ = std::make_unique<ImuBuffer>();
+    imuBatches_ = std::make_unique<ImuBatcher>(IMU_EVENT);
+    imuBatches_->setPeriod(ui_->imuBatch->value());
+    connect(ui_->imuBatch, &QSpinBox::valueChanged, [this](int ms)
+    {
+        imuBatches_->setPeriod(ms);
+    });
+    // streams the application does not need are dropped in the callbacks, before they are copied or posted
+    const std::array<std::tuple<Stream, QCheckBox*, QSpinBox*, QDoubleSpinBox*>, static_cast<size_t>(Stream::Count)> streams =
+    {{
+        { Stream::Processed, ui_->subImage, ui_->subImageEvery, ui_->subImageRate },
+        { Stream::Prescan, ui_->subPrescan, ui_->subPrescanEvery, ui_->subPrescanRate },
+        { Stream::Rf, ui_->subRf, ui_->subRfEvery, ui_->subRfRate },
+        { Stream::Spectrum, ui_->subSpectrum, ui_->subSpectrumEvery, ui_->subSpectrumRate },
+        { Stream::Imu, ui_->subImu, ui_->subImuEvery, ui_->subImuRate },
+    }};
+    for (const auto& [stream, enable, every, rate] : streams)
+    {
+        auto& sub = subscription(stream);
+        sub.setEnabled(enable->isChecked());
+        sub.setDecimation(every->value());
+        sub.setMaxRate(rate->value());
+        connect(enable, &QCheckBox::toggled, [&sub](bool en) { sub.setEnabled(en); });
+        connect(every, &QSpinBox::valueChanged, [&sub](int n) { sub.setDecimation(n); });
+        connect(rate, &QDoubleSpinBox::valueChanged, [&sub](double hz) { sub.setMaxRate(hz); });
+    }
+    motion_ = std::make_unique<MotionEstimator>();
+    // a single thread keeps the estimates in frame order, the estimator itself spreads its work across the shared pool
+    motionThread_.setMaxThreadCount(1);
+    connect(ui_->motion, &QCheckBox::toggled, [this](bool en)
+    {
+        motionReset_ = true;
+        motionPending_ = QImage();
+        if (!en)
+            ui_->motionData->clear();
+    });
+    connect(ui_->motionSource, &QComboBox::currentIndexChanged, [this](int)
+    {
+        motionReset_ = true;
+        motionPending_ = QImage();
+    });
+    volume_ = std::make_unique<VolumeCompounder>();
+    tgc_ = std::make_unique<TgcNormalizer>();
+    prescanTgc_ = std::make_unique<TgcNormalizer>();
+    compositor_ = std::make_unique<OverlayCompositor>();
+    resolution_ = std::make_unique<ResolutionManager>();
+    cine_ = std::make_unique<CineBuffer>();
+    format_ = std::make_unique<FormatSelector>();
+    connect(ui_->adaptiveFormat, &QCheckBox::toggled, [this](bool en)
+    {
+        format_->reset(static_cast<CusImageFormat>(ui_->imageFormat->currentIndex()));
+        format_->setEnabled(en);
+    });
+    connect(format_.get(), &FormatSelector::formatChanged, [this](CusImageFormat format, const QString& reason)
+    {
+        QSignalBlocker block(ui_->imageFormat);
+        ui_->imageFormat->setCurrentIndex(static_cast<int>(format));
+        ui_->status->showMessage(QStringLiteral("Stream format changed to %1 (%2)").arg(ui_->imageFormat->currentText(), reason));
+    });
+    // a dropped link is restored with the settings of the session, the displays keep their state in the meantime
+    reconnect_ = std::make_unique<ReconnectManager>();
+    // frames withheld by the subscriptions never reach the gui, so the link is watched through the arrivals
+    reconnect_->setArrivals([this]() { return imageStats_.counters().frames_; });
+    connect(ui_->autoReconnect, &QCheckBox::toggled, reconnect_.get(), &ReconnectManager::setEnabled);
+    connect(reconnect_.get(), &ReconnectManager::lost, [this]()
+    {
+        imageTimer_.stop();
+        ui_->status->showMessage(QStringLiteral("Connection lost, reconnecting..."));
+    });
+    connect(reconnect_.get(), &ReconnectManager::resumed, [this](int imagePort, int imuPort)
+    {
+        castSetFormat(static_cast<CusImageFormat>(ui_->imageFormat->currentIndex()));
+        const QSize output = resolution_->outputSize();
+        if (!output.isEmpty())
+            castSetOutputSize(output.width(), output.height());
+        castSeparateOverlays(ui_->separateOverlays->isChecked() ? 1 : 0);
+        ui_->status->showMessage(QStringLiteral("Reconnected, streaming port: %1, imu port: %2").arg(imagePort).arg(imuPort));
+    });
+    connect(reconnect_.get(), &ReconnectManager::recovered, [this](double latency)
+    {
+        ui_->status->showMessage(QStringLiteral("Stream resumed after %1 ms").arg(latency, 0, 'f', 0));
+    });
+    cineTimer_.setSingleShot(true);
+    cineTimer_.setTimerType(Qt::PreciseTimer);
+    connect(&cineTimer_, &QTimer::timeout, this, &Caster::playNextCineFrame);
+    connect(ui_->cineSlider, &QSlider::valueChanged, this, &Caster::onCineSeek);
+    connect(ui_->cinePlay, &QPushButton::toggled, this, &Caster::onCinePlay);
+    connect(image_, &UltrasoundImage::resized, resolution_.get(), &ResolutionManager::setDisplaySize);
+    for (auto spin : { ui_->roiX, ui_->roiY, ui_->roiWidth, ui_->roiHeight })
+        connect(spin, &QDoubleSpinBox::valueChanged, this, &Caster::updateRoi);
+    connect(ui_->roi, &QCheckBox::toggled, this, &Caster::updateRoi);
+    connect(ui_->roiUnits, &QComboBox::currentIndexChanged, this, &Caster::updateRoi);
+    connect(ui_->resetVolume, &QPushButton::clicked, this, &Caster::onResetVolume);
+    connect(ui_->separateOverlays, &QCheckBox::toggled, this, &Caster::onSeparateOverlays);
+    connect(ui_->rfWaterfall, &QCheckBox::toggled, signal_, &RfSignal::setWaterfall);
+    connect(ui_->predictImu, &QCheckBox::toggled, [this](bool en)
+    {
+        render_->setPrediction(en ? IMU_LATENCY : 0);
+    });
+    connect(ui_->tiledView, &QCheckBox::toggled, [this](bool en)
+    {
+        tiles_->setVisible(en);
+        image_->setVisible(!en);
+    });
+    // the api connects to a single scanner per process, so the tiles show its two image streams
+    tiles_->setTiles(2);
+    tiles_->setName(0, QStringLiteral("Processed"));
+    tiles_->setName(1, QStringLiteral("Pre-Scan"));
+    // display mapping of 8 bit frames is applied locally, changes show immediately even while frozen
+    connect(ui_->imageFormat, &QComboBox::currentIndexChanged, [this](int index)
+    {
+        if (connected_ && castSetFormat(static_cast<CusImageFormat>(index)) < 0)
+            ui_->status->showMessage(QStringLiteral("Failed to set the stream format"));
+    });
+    connect(ui_->lutGain, &QSlider::valueChanged, [this](int db)
+    {
+        image_->lut().setGain(db);
+        image_->applyLut();
+    });
+    connect(ui_->lutGamma, &QSlider::valueChanged, [this](int gamma)
+    {
+        image_->lut().setGamma(gamma / 100.0);
+        image_->applyLut();
+    });
+    connect(ui_->lutColormap, &QComboBox::currentIndexChanged, [this](int index)
+    {
+        image_->lut().setColormap(static_cast<Colormap>(index));
+        image_->applyLut();
+    });
+    connect(ui_->fuseImu, &QCheckBox::toggled, [this](bool en)
+    {
+        imu_->setFusion(en);
+    });
 
     render_ = new ProbeRender(QGuiApplication::primaryScreen());
     ui_->render->addWidget(QWidget::createWindowContainer(render_));
@@ -36,6 +191,9 @@ Caster::Caster(QWidget *parent) : QMainWindow(parent), connected_(false), frozen
 
     connect(&imageTimer_, &QTimer::timeout, [this]()
     {
+        // a dropped link being restored is not a firewall issue, and no images are expected while they are not subscribed
+        if (reconnect_->recovering() || !subscription(Stream::Processed).enabled())
+            return;
         image_->setNoImage(true);
         lasttime_ = 0;
         updateCaptureButtons();
@@ -45,6 +203,7 @@ Caster::Caster(QWidget *parent) : QMainWindow(parent), connected_(false), frozen
     QObject::connect(reset, &QPushButton::clicked, [this]()
     {
         render_->reset();
+        imuStream_.invalidate();
         imuSamples_ = 0;
     });
 }
@@ -52,12 +211,14 @@ Caster::Caster(QWidget *parent) : QMainWindow(parent), connected_(false), frozen
 /// destructor
 Caster::~Caster()
 {
+    motionThread_.waitForDone();
     delete ui_;
 }
 
 /// called when the window is closing to clean up the clarius library
 void Caster::closeEvent(QCloseEvent*)
 {
+    reconnect_->stop();
     if (connected_)
         castDisconnect(nullptr);
 
@@ -69,28 +230,42 @@ void Caster::closeEvent(QCloseEvent*)
 /// @return handling status
 bool Caster::event(QEvent *event)
 {
+    // frame events are only notifications, the latest frames are taken from their slots, and any that were replaced
+    // while the gui was busy are skipped rather than replayed
     if (event->type() == IMAGE_EVENT)
     {
-        auto evt = static_cast<event::Image*>(event);
-        newProcessedImage(evt->data_, evt->width_, evt->height_, evt->bpp_, evt->size_, evt->imu_);
-        image_->setNoImage(false);
-        lasttime_ = evt->tm_;
-        updateCaptureButtons();
-        if (imageTimer_.isActive())
-            imageTimer_.stop();
-
+        // overlays are taken first so they are ready to pair with the grayscale frame they belong to
+        auto overlay = overlays_.take();
+        if (overlay)
+            newProcessedImage(*overlay);
+        auto evt = images_.take();
+        if (evt)
+        {
+            reconnect_->frameReceived(evt->fps_);
+            newProcessedImage(*evt);
+            image_->setNoImage(false);
+            lasttime_ = evt->tm_;
+            updateCaptureButtons();
+            if (imageTimer_.isActive())
+                imageTimer_.stop();
+        }
+        updateSkipped();
         return true;
     }
     else if (event->type() == PRESCAN_EVENT)
     {
-        auto evt = static_cast<event::Image*>(event);
-        newPrescanImage(evt->data_, evt->width_, evt->height_, evt->bpp_, evt->size_);
+        auto evt = prescanImages_.take();
+        if (evt)
+            newPrescanImage(evt->data_, evt->width_, evt->height_, evt->bpp_, evt->size_, evt->tm_, evt->tgc_, evt->micronsPerPixel_);
+        updateSkipped();
         return true;
     }
     else if (event->type() == RF_EVENT)
     {
-        auto evt = static_cast<event::RfImage*>(event);
-        newRfData(evt->data_, evt->width_, evt->height_, evt->bpp_, evt->lateral_, evt->axial_);
+        auto evt = rfData_.take();
+        if (evt)
+            newRfData(evt->data_, evt->width_, evt->height_, evt->bpp_, evt->lateral_, evt->axial_);
+        updateSkipped();
         return true;
     }
     else if (event->type() == SPECTRUM_EVENT)
@@ -130,8 +305,9 @@ bool Caster::event(QEvent *event)
     }
     else if (event->type() == IMU_EVENT)
     {
-        auto evt = static_cast<event::Imu*>(event);
-        newImuData(evt->imu_);
+        auto batch = imuBatches_->take();
+        if (batch && !batch->empty())
+            newImuData(*batch);
         return true;
     }
 
@@ -145,13 +321,142 @@ void Caster::setError(const QString& err)
     ui_->status->showMessage(QStringLiteral("Error: %1").arg(err));
 }
 
+/// updates the cine information
+void Caster::updateCine()
+{
+    ui_->cineData->setText(QStringLiteral("Cine: %1 Frames, %2 s, %3 MB").arg(cine_->size()).arg(cine_->duration(), 0, 'f', 1)
+        .arg(static_cast<double>(cine_->bytes()) / (1024.0 * 1024.0), 0, 'f', 1));
+}
+
+/// displays a frame from the cine
+/// @param[in] index the frame index, from the oldest retained frame
+void Caster::onCineSeek(int index)
+{
+    if (!frozen_ || index < 0 || index >= cine_->size())
+        return;
+
+    const CineFrame& f = cine_->frame(index);
+    image_->loadImage(f.data_.data(), f.width_, f.height_, f.bpp_, static_cast<int>(f.data_.size()));
+    if (!f.imu_.isNull())
+        render_->update(f.imu_);
+    // captures refer to the frame being reviewed
+    lasttime_ = f.tm_;
+    ui_->cineData->setText(QStringLiteral("Cine: Frame %1 of %2, %3 s").arg(index + 1).arg(cine_->size())
+        .arg(static_cast<double>(f.tm_ - cine_->frame(0).tm_) / 1e9, 0, 'f', 2));
+}
+
+/// starts or stops cine playback
+/// @param[in] en flag to play
+void Caster::onCinePlay(bool en)
+{
+    ui_->cinePlay->setText(en ? QStringLiteral("Pause Cine") : QStringLiteral("Play Cine"));
+    if (!en)
+    {
+        cineTimer_.stop();
+        return;
+    }
+    playNextCineFrame();
+}
+
+/// advances playback by one frame and schedules the next one after the original frame interval
+void Caster::playNextCineFrame()
+{
+    if (!frozen_ || cine_->size() < 2 || !ui_->cinePlay->isChecked())
+        return;
+
+    const int index = (ui_->cineSlider->value() + 1) % cine_->size();
+    ui_->cineSlider->setValue(index);
+    // the interval to the next frame, looping back to the start waits one average frame interval
+    const int next = (index + 1) % cine_->size();
+    const double interval = next ? static_cast<double>(cine_->frame(next).tm_ - cine_->frame(index).tm_) / 1e6
+                                 : cine_->duration() * 1000.0 / (cine_->size() - 1);
+    cineTimer_.start(std::max(static_cast<int>(interval + 0.5), 1));
+}
+
+/// updates the skipped frame counters in the status bar
+void Caster::updateSkipped()
+{
+    skipped_->setText(QStringLiteral("Skipped: %1 image, %2 overlay, %3 pre-scan, %4 rf")
+        .arg(images_.skipped()).arg(overlays_.skipped()).arg(prescanImages_.skipped()).arg(rfData_.skipped()));
+}
+
+/// formats the counters of a stream for the link tooltip
+/// @param[in] name the stream name
+/// @param[in] c the stream counters
+/// @return the formatted counters
+static QString describeStats(const QString& name, const StreamStats::Counters& c)
+{
+    QString text = QStringLiteral("%1: %2 received, sequence %3, %4 lost, %5 reordered, %6 duplicated, %7 rate changes, jitter %8 ms")
+        .arg(name).arg(c.frames_).arg(c.sequence_).arg(c.lost_).arg(c.reordered_).arg(c.duplicates_).arg(c.rateChanges_)
+        .arg(c.jitter_, 0, 'f', 2);
+    QStringList gaps, jitters;
+    for (auto i = 0; i < StreamStats::kGapBins; i++)
+        gaps << QStringLiteral("%1: %2").arg(StreamStats::gapBin(i)).arg(c.gaps_[i]);
+    for (auto i = 0; i < StreamStats::kJitterBins; i++)
+        jitters << QStringLiteral("%1: %2").arg(StreamStats::jitterBin(i)).arg(c.jitters_[i]);
+    return text + QStringLiteral("\n  lost runs  ") + gaps.join(QStringLiteral(", ")) +
+        QStringLiteral("\n  transit    ") + jitters.join(QStringLiteral(", "));
+}
+
+/// updates the link statistics in the status bar
+/// @details the processed image stream is flagged when more than 1% of its frames were lost over the last update, or
+///          when its jitter exceeds half a frame interval, frames skipped by the gui or withheld by the stream
+///          subscriptions are reported separately
+void Caster::updateStats()
+{
+    const auto c = imageStats_.counters();
+    const auto expected = (c.frames_ + c.lost_) - (lastStats_.frames_ + lastStats_.lost_);
+    const auto lost = c.lost_ - lastStats_.lost_;
+    const double loss = expected ? 100.0 * static_cast<double>(lost) / static_cast<double>(expected) : 0.0;
+    const bool degraded = loss > 1.0 || (c.fps_ > 0 && c.jitter_ > 500.0 / c.fps_);
+    lastStats_ = c;
+
+    link_->setText(QStringLiteral("Lost: %1 (%2%), jitter: %3 ms").arg(c.lost_).arg(loss, 0, 'f', 1).arg(c.jitter_, 0, 'f', 1));
+    link_->setStyleSheet(degraded ? QStringLiteral("color: red") : QString());
+    skipped_->setToolTip(QStringLiteral("Withheld by the stream subscriptions: %1 image, %2 pre-scan, %3 rf, %4 spectrum, %5 imu")
+        .arg(subscription(Stream::Processed).dropped()).arg(subscription(Stream::Prescan).dropped()).arg(subscription(Stream::Rf).dropped())
+        .arg(subscription(Stream::Spectrum).dropped()).arg(subscription(Stream::Imu).dropped()));
+    link_->setToolTip(describeStats(QStringLiteral("images"), c) + QStringLiteral("\n") +
+        describeStats(QStringLiteral("pre-scan"), prescanStats_.counters()) + QStringLiteral("\n") +
+        describeStats(QStringLiteral("rf"), rfStats_.counters()) +
+        QStringLiteral("\nreconnects: %1, last reconnect latency: %2 ms").arg(reconnect_->reconnects()).arg(reconnect_->lastLatency(), 0, 'f', 0));
+}
+
+/// applies the region of interest settings
+/// @details regions in pixels refer to the transmitted image, regions in millimeters to the image origin, with the
+///          horizontal position lateral to the probe center and the vertical position in depth
+void Caster::updateRoi()
+{
+    const bool mm = ui_->roiUnits->currentIndex() == 1;
+    const double scale = mm ? 1000.0 : 1.0;
+    if (ui_->roi->isChecked())
+        roi_.set(QRectF(ui_->roiX->value() * scale, ui_->roiY->value() * scale, ui_->roiWidth->value() * scale, ui_->roiHeight->value() * scale),
+                 mm ? RegionOfInterest::Units::Microns : RegionOfInterest::Units::Pixels);
+    else
+        roi_.clear();
+    // only a region in millimeters keeps its content when the output size changes
+    if (!ui_->roi->isChecked() || !mm)
+        resolution_->setCrop(QSizeF(1, 1));
+}
+
 /// called when the freeze status changes
 /// @param[in] en the freeze state
 void Caster::setFreeze(bool en)
 {
     frozen_ = en;
+    reconnect_->setFrozen(en);
     if (!frozen_)
         lasttime_ = 0;
+    // the cine can only be reviewed while frozen, it starts on the latest frame
+    ui_->cinePlay->setChecked(false);
+    ui_->cinePlay->setEnabled(en && !cine_->empty());
+    ui_->cineSlider->setEnabled(en && !cine_->empty());
+    if (en && !cine_->empty())
+    {
+        QSignalBlocker block(ui_->cineSlider);
+        ui_->cineSlider->setRange(0, cine_->size() - 1);
+        ui_->cineSlider->setValue(cine_->size() - 1);
+    }
     ui_->status->showMessage(QStringLiteral("Image: %1").arg(en ? QStringLiteral("Frozen") : QStringLiteral("Running")));
     ui_->freeze->setText(en ? QStringLiteral("Run") : QStringLiteral("Stop"));
     ui_->request->setEnabled(en);
@@ -188,17 +493,121 @@ void Caster::setProgress(int progress)
     ui_->progress->setValue(progress);
 }
 
-/// called when a new image has been sent
-/// @param[in] img the image data
-/// @param[in] w width of the image
-/// @param[in] h height of the image
+/// converts a received frame to a grayscale image that owns its pixels
+/// @param[in] data the frame data, raw or compressed
+/// @param[in] w width of the frame
+/// @param[in] h height of the frame
 /// @param[in] bpp the bits per pixel
-/// @param[in] sz size of the image in bytes
-void Caster::newProcessedImage(const void* img, int w, int h, int bpp, int sz, const QQuaternion& imu)
+/// @param[in] sz size of the frame in bytes
+/// @return the grayscale frame, null if it could not be decoded
+static QImage grayscale(const void* data, int w, int h, int bpp, int sz)
 {
-    image_->loadImage(img, w, h, bpp, sz);
-    if (!imu.isNull())
-        render_->update(imu);
+    const auto bits = static_cast<const uchar*>(data);
+    if (sz != w * h * (bpp / 8))
+        return QImage::fromData(bits, sz).convertToFormat(QImage::Format_Grayscale8);
+    else if (bpp == 8)
+        return QImage(bits, w, h, w, QImage::Format_Grayscale8).copy();
+    else
+        return QImage(bits, w, h, w * 4, QImage::Format_ARGB32).convertToFormat(QImage::Format_Grayscale8);
+}
+
+/// called when a new image has been sent
+/// @param[in] evt the image event holding the image data and its attributes
+void Caster::newProcessedImage(const event::Image& evt)
+{
+    // frames are retained as received so they can be reviewed after freezing without asking the scanner again
+    if (!evt.overlay_ && !frozen_)
+    {
+        cine_->add(evt.data_, evt.size_, evt.width_, evt.height_, evt.bpp_, evt.tm_, evt.imu_);
+        updateCine();
+    }
+
+    // the tiled view decodes on its own threads and takes over the received buffer, the processing stages below are
+    // bound to the single view
+    if (ui_->tiledView->isChecked())
+    {
+        if (!evt.overlay_)
+            images_.recycle(tiles_->push(0, images_.release(), evt.width_, evt.height_, evt.bpp_));
+        return;
+    }
+
+    // motion is tracked and the volume compounded from the frame as received, the display mapping and overlays would
+    // otherwise be taken for tissue
+    const bool track = ui_->motion->isChecked() && ui_->motionSource->currentIndex() == 0;
+    const bool compound = ui_->compound->isChecked() && !evt.imu_.isNull();
+    if (!evt.overlay_ && (track || compound))
+    {
+        const QImage gray = grayscale(evt.data_, evt.width_, evt.height_, evt.bpp_, evt.size_);
+        if (track)
+            trackMotion(gray, evt.tm_);
+        if (compound)
+        {
+            volume_->insert(gray, evt.micronsPerPixel_, evt.originX_, evt.originY_, evt.angle_, evt.imu_);
+
+            // reslice across the sweep every so often, through the elevation and axial directions of the latest frame
+            if (++volumeFrames_ >= 10)
+            {
+                volumeFrames_ = 0;
+                const auto sz = ui_->volumeSlice->size();
+                const QImage slice = volume_->slice(volume_->center(), evt.imu_.rotatedVector(QVector3D(0, 1, 0)), evt.imu_.rotatedVector(QVector3D(0, 0, 1)),
+                    sz.width(), sz.height(), volume_->voxelSize());
+                ui_->volumeSlice->setPixmap(QPixmap::fromImage(slice));
+            }
+        }
+    }
+
+    // the tgc is removed from the received gray levels, ahead of the display mapping and of overlay compositing,
+    // compressed frames are left as they are
+    const void* data = evt.data_;
+    if (ui_->normalizeTgc->isChecked() && !evt.overlay_ && evt.size_ == evt.width_ * evt.height_ * (evt.bpp_ / 8))
+    {
+        // the correction table is only rebuilt when the tgc or the geometry changes
+        tgc_->update(evt.tgc_, evt.height_, evt.micronsPerPixel_, evt.originY_);
+        normalized_.assign(static_cast<const uint8_t*>(evt.data_), static_cast<const uint8_t*>(evt.data_) + evt.size_);
+        tgc_->apply(normalized_.data(), evt.width_, evt.height_, evt.bpp_, evt.width_ * (evt.bpp_ / 8));
+        data = normalized_.data();
+    }
+
+    // separated overlays are paired with their grayscale frame before anything is displayed
+    if (ui_->separateOverlays->isChecked() && evt.size_ == evt.width_ * evt.height_ * 4)
+    {
+        compositor_->add(data, evt.width_, evt.height_, evt.tm_, evt.overlay_);
+        CompositeFrame frame;
+        bool shown = false;
+        while (compositor_->take(frame))
+        {
+            image_->setImageSize(frame.width_, frame.height_);
+            QImage& out = image_->image();
+
+            if (ui_->blendOverlays->isChecked())
+            {
+                OverlayCompositor::composite(frame, out.bits(), static_cast<int>(out.bytesPerLine()));
+                image_->loadOverlay(nullptr, 0, 0);
+                image_->refresh();
+            }
+            else
+            {
+                image_->loadImage(frame.gray_, frame.width_, frame.height_, 32, frame.width_ * frame.height_ * 4);
+                image_->loadOverlay(frame.overlay_, frame.width_, frame.height_);
+            }
+            shown = true;
+        }
+        if (!shown)
+            return;
+    }
+    else if (evt.overlay_)
+        return;
+    else
+        image_->loadImage(data, evt.width_, evt.height_, evt.bpp_, evt.size_);
+
+    // a region given in microns is shown in full detail by requesting a larger output size
+    if (roi_.active() && roi_.units() == RegionOfInterest::Units::Microns && evt.frameWidth_ > 0 && evt.frameHeight_ > 0)
+        resolution_->setCrop(QSizeF(static_cast<double>(evt.width_) / evt.frameWidth_, static_cast<double>(evt.height_) / evt.frameHeight_));
+
+    // frame tagged orientations match the displayed image exactly, so they are not predicted. while imu samples are
+    // streamed the render already holds a newer orientation and its angular velocity, which the older frame would undo
+    if (!evt.imu_.isNull() && (!imuStream_.isValid() || imuStream_.hasExpired(IMU_TIMEOUT)))
+        render_->update(evt.imu_);
 }
 
 /// called when a new pre-scan image has been sent
@@ -207,14 +616,98 @@ void Caster::newProcessedImage(const void* img, int w, int h, int bpp, int sz, c
 /// @param[in] h height of the image
 /// @param[in] bpp the bits per pixel
 /// @param[in] sz size of the image in bytes
-void Caster::newPrescanImage(const void* img, int w, int h, int bpp, int sz)
+/// @param[in] tm the image timestamp in nanoseconds
+/// @param[in] tgc the tgc points
+/// @param[in] micronsPerSample axial size of a sample in microns
+void Caster::newPrescanImage(const void* img, int w, int h, int bpp, int sz, long long int tm, const CusTgcInfo* tgc, double micronsPerSample)
 {
+    // pre-scan frames keep the speckle in the acquisition geometry, the scan conversion interpolates it across the sector
+    if (ui_->motion->isChecked() && ui_->motionSource->currentIndex() == 1)
+        trackMotion(grayscale(img, w, h, bpp, sz), tm);
+
+    // the samples of each line run down the rows, so the tgc is removed row by row as in the processed images
+    const bool normalize = ui_->normalizeTgc->isChecked() && sz == (w * h * (bpp / 8));
+    if (normalize)
+        prescanTgc_->update(tgc, h, micronsPerSample);
+
+    // the tiled view takes over the received buffer, so the tgc is removed in place
+    if (ui_->tiledView->isChecked())
+    {
+        std::vector<char> frame = prescanImages_.release();
+        if (normalize)
+            prescanTgc_->apply(reinterpret_cast<uint8_t*>(frame.data()), w, h, bpp, w * (bpp / 8));
+        prescanImages_.recycle(tiles_->push(1, std::move(frame), w, h, bpp));
+        return;
+    }
+
+    if (normalize)
+    {
+        normalizedPrescan_.assign(static_cast<const uint8_t*>(img), static_cast<const uint8_t*>(img) + sz);
+        prescanTgc_->apply(normalizedPrescan_.data(), w, h, bpp, w * (bpp / 8));
+        img = normalizedPrescan_.data();
+    }
+
     if (sz == (w * h * (bpp / 8)))
-        prescan_ = QImage(reinterpret_cast<const uchar*>(img), w, h, QImage::Format_ARGB32);
+        prescan_ = QImage(reinterpret_cast<const uchar*>(img), w, h, (bpp == 8) ? QImage::Format_Grayscale8 : QImage::Format_ARGB32);
     else
         prescan_.loadFromData(static_cast<const uchar*>(img), sz, "JPG");
 }
 
+/// starts a motion estimate on the motion thread, or keeps the frame for when the running estimate completes
+/// @param[in] frame the grayscale frame, not shared with the gui
+/// @param[in] tm the frame timestamp in nanoseconds
+void Caster::trackMotion(QImage frame, long long int tm)
+{
+    if (frame.isNull())
+        return;
+
+    // frames arriving while busy replace each other, so the tracker never falls behind the stream
+    if (motionBusy_)
+    {
+        motionPending_ = std::move(frame);
+        motionPendingTm_ = tm;
+        return;
+    }
+
+    motionBusy_ = true;
+    const bool reset = motionReset_;
+    motionReset_ = false;
+    motionThread_.start(QRunnable::create([this, frame, tm, reset]()
+    {
+        if (reset)
+            motion_->reset();
+        MotionField field;
+        const bool tracked = motion_->process(frame, tm, field);
+        QMetaObject::invokeMethod(this, [this, tracked, field]()
+        {
+            motionTracked(tracked, field);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+/// called on the gui thread when a motion estimate completes
+/// @param[in] tracked flag that a previous frame was available to track against
+/// @param[in] field the estimated motion
+void Caster::motionTracked(bool tracked, const MotionField& field)
+{
+    motionBusy_ = false;
+    if (tracked && ui_->motion->isChecked() && !motionReset_)
+    {
+        if (field.valid_)
+            ui_->motionData->setText(QStringLiteral("dx: %1px, dy: %2px, rotation: %3\u00b0")
+                .arg(field.translation_.x(), 0, 'f', 1).arg(field.translation_.y(), 0, 'f', 1).arg(qRadiansToDegrees(field.rotation_), 0, 'f', 2));
+        else
+            ui_->motionData->setText(QStringLiteral("Not enough texture to track"));
+    }
+
+    if (!motionPending_.isNull())
+    {
+        QImage frame;
+        std::swap(frame, motionPending_);
+        trackMotion(std::move(frame), motionPendingTm_);
+    }
+}
+
 /// called when new rf data has been sent
 /// @param[in] rfdata the rf data
 /// @param[in] l # of lines
@@ -272,6 +765,17 @@ void Caster::connected(int imagePort, int imuPort)
     {
         ui_->status->showMessage(QString("Connection successful, streaming port: %1, imu port: %2").arg(imagePort).arg(imuPort));
         connected_ = true;
+        resolution_->reset();
+        imageStats_.reset();
+        prescanStats_.reset();
+        rfStats_.reset();
+        for (auto& sub : subscriptions_)
+            sub.reset();
+        lastStats_ = StreamStats::Counters{};
+        castSetFormat(static_cast<CusImageFormat>(ui_->imageFormat->currentIndex()));
+        format_->reset(static_cast<CusImageFormat>(ui_->imageFormat->currentIndex()));
+        tiles_->setName(0, QStringLiteral("%1:%2 Processed").arg(ui_->ip->text(), ui_->port->text()));
+        tiles_->setName(1, QStringLiteral("%1:%2 Pre-Scan").arg(ui_->ip->text(), ui_->port->text()));
         ui_->connect->setText("Disconnect");
         ui_->freeze->setEnabled(true);
         ui_->shallower->setEnabled(true);
@@ -312,12 +816,15 @@ void Caster::onConnect()
         {
             ui_->status->showMessage("Connection attempt failed");
         }
+        else
+            reconnect_->start(ui_->ip->text(), ui_->port->text().toUInt());
 
         settings_->setValue("ip", ui_->ip->text());
         settings_->setValue("port", ui_->port->text());
     }
     else
     {
+        reconnect_->stop();
         if (castDisconnect([](int ret)
         {
             _me->disconnected(ret == CUS_SUCCESS);
@@ -394,12 +901,15 @@ void Caster::onCaptureImage()
         ui_->status->showMessage("Failed to initialize capture");
         return;
     }
+    // annotations are placed in view coordinates, the capture is in the coordinates of the negotiated output size
+    const QTransform toImage = image_->toImage();
     const std::vector<LabelInfo> labels = image_->getLabels();
     for (const LabelInfo& label : labels)
     {
         const std::string text = label.text_.toStdString();
-        const QPointF center = label.rect_.center();
-        if (castAddLabelOverlay(captureID, text.c_str(), center.x(), center.y(), label.rect_.width(), label.rect_.height()) < 0)
+        const QRectF rect = toImage.mapRect(label.rect_);
+        const QPointF center = rect.center();
+        if (castAddLabelOverlay(captureID, text.c_str(), center.x(), center.y(), rect.width(), rect.height()) < 0)
             ui_->status->showMessage("Failed to add label " + label.text_ + " to capture");
     }
     const std::vector<TraceInfo> traces = image_->getTraces();
@@ -409,28 +919,38 @@ void Caster::onCaptureImage()
         std::vector<double> points;
         for (const QPointF& pt : trace.points_)
         {
-            points.push_back(pt.x());
-            points.push_back(pt.y());
+            const QPointF mapped = toImage.map(pt);
+            points.push_back(mapped.x());
+            points.push_back(mapped.y());
         }
-        if (castAddMeasurement(captureID, CusMeasurementTypeTraceDistance, text.c_str(), points.data(), static_cast<int>(points.size())) < 0)
+        // a trace whose calipers were brought back together encloses an area
+        const bool closed = trace.area_ > 0 && QLineF(trace.points_.front(), trace.points_.back()).length() < 20.0;
+        const CusMeasurementType type = closed ? CusMeasurementTypeTraceArea : CusMeasurementTypeTraceDistance;
+        if (castAddMeasurement(captureID, type, text.c_str(), points.data(), static_cast<int>(points.size())) < 0)
             ui_->status->showMessage("Failed to add trace measurement " + trace.text_ + " to capture");
     }
-    const QImage overlayImage = image_->overlayImage();
-    if (!overlayImage.isNull())
+    // the mask is kept up to date while drawing and its rows are packed, so it is passed without a copy unless the
+    // negotiated output size differs from the view
+    if (image_->hasOverlay())
     {
         const QColor overlayColor = image_->overlayColor();
-        const int height = overlayImage.height();
-        const int width = overlayImage.width();
-        std::vector<unsigned char> bytes(width * height);
-        for (int i = 0; i < height; ++i)
+        const QImage& mask = image_->overlayImage();
+        const QSize size = image_->image().size();
+        const uchar* bits = mask.constBits();
+        std::vector<uchar> packed;
+        if (mask.size() != size)
         {
-            std::memcpy(bytes.data() + i * width, overlayImage.scanLine(i), width);
+            const QImage scaled = mask.scaled(size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+            packed.resize(static_cast<size_t>(size.width()) * size.height());
+            for (int i = 0; i < size.height(); ++i)
+                std::memcpy(packed.data() + static_cast<size_t>(i) * size.width(), scaled.constScanLine(i), size.width());
+            bits = packed.data();
         }
         castAddImageOverlay(
             captureID,
-            bytes.data(),
-            width,
-            height,
+            bits,
+            size.width(),
+            size.height(),
             static_cast<float>(overlayColor.redF()),
             static_cast<float>(overlayColor.greenF()),
             static_cast<float>(overlayColor.blueF()),
@@ -455,6 +975,24 @@ void Caster::onClearScreen()
     image_->clearOverlays();
 }
 
+/// called when the separate overlays option is toggled
+/// @param[in] en the enable flag
+void Caster::onSeparateOverlays(bool en)
+{
+    compositor_->clear();
+    image_->loadOverlay(nullptr, 0, 0);
+    if (castSeparateOverlays(en ? 1 : 0) < 0)
+        ui_->status->showMessage("Could not change overlay separation");
+}
+
+/// called when the resetVolume button is clicked
+void Caster::onResetVolume()
+{
+    volume_->reset();
+    volumeFrames_ = 0;
+    ui_->volumeSlice->clear();
+}
+
 /// handles the result of a raw data request
 /// @param[in] sz size of the raw data available, or status if not available
 void Caster::rawData(int sz)
@@ -538,13 +1076,17 @@ bool Caster::rawDataReady(bool success)
     return true;
 }
 
-/// called when a new imu data been sent
-/// @param[in] imu the imu data if valid
-void Caster::newImuData(const QQuaternion& imu)
+/// called when a batch of streamed imu data is ready
+/// @param[in] batch the samples collected since the previous batch
+/// @details the render follows the orientation at the latest sample, with the angular velocity averaged over the batch
+void Caster::newImuData(const ImuBatch& batch)
 {
+    const QQuaternion imu = imu_->orientation(batch.tm_.back());
     if (!imu.isNull())
     {
-        render_->update(imu);
-        ui_->imuData->setText(QStringLiteral("Collected %1 IMU Samples").arg(++imuSamples_));
+        render_->update(imu, batch.meanGyro());
+        imuStream_.start();
+        imuSamples_ += static_cast<uint32_t>(batch.size());
+        ui_->imuData->setText(QStringLiteral("Collected %1 IMU Samples").arg(imuSamples_));
     }
 }
@@ -1,11 +1,24 @@
 #pragma once
 
+#include <cast/cast_def.h>
+
 namespace Ui
 {
     class Caster;
 }
 
 class ProbeRender;
+class ImuBuffer;
+class ImuBatcher;
+struct ImuBatch;
+class MotionEstimator;
+struct MotionField;
+class VolumeCompounder;
+class TgcNormalizer;
+class OverlayCompositor;
+class ResolutionManager;
+class CineBuffer;
+class FormatSelector;
 
 #define IMAGE_EVENT     static_cast<QEvent::Type>(QEvent::User + 1)
 #define PRESCAN_EVENT   static_cast<QEvent::Type>(QEvent::User + 2)
@@ -30,8 +43,27 @@ namespace event
         /// @param[in] h the image height
         /// @param[in] bpp the image bits per pixel
         /// @param[in] sz total size of the image
-        Image(QEvent::Type evt, const void* data, long long int tm, int w, int h, int bpp, int sz, const QQuaternion& imu)
-            : QEvent(evt), data_(data), tm_(tm), width_(w), height_(h), bpp_(bpp), size_(sz), imu_(imu) { }
+        /// @param[in] imu the latest imu orientation
+        /// @param[in] mpp microns per pixel
+        /// @param[in] ox image origin in microns in the horizontal axis
+        /// @param[in] oy image origin in microns in the vertical axis
+        /// @param[in] angle acquisition angle for volumetric data
+        /// @param[in] tgc the tgc points, null if not available
+        /// @param[in] overlay flag that the image is an overlay without grayscale
+        Image(QEvent::Type evt, const void* data, long long int tm, int w, int h, int bpp, int sz, const QQuaternion& imu,
+              double mpp = 0, double ox = 0, double oy = 0, double angle = 0, const CusTgcInfo* tgc = nullptr, bool overlay = false)
+            : QEvent(evt), data_(data), tm_(tm), width_(w), height_(h), bpp_(bpp), size_(sz), imu_(imu),
+              micronsPerPixel_(mpp), originX_(ox), originY_(oy), angle_(angle), overlay_(overlay), format_(Uncompressed), fps_(0),
+              frameWidth_(w), frameHeight_(h), frameSize_(sz)
+        {
+            if (tgc)
+                std::memcpy(tgc_, tgc, sizeof(tgc_));
+            else
+                std::memset(tgc_, 0, sizeof(tgc_));
+        }
+        /// constructs an empty image to be filled in later
+        /// @param[in] evt the event type
+        explicit Image(QEvent::Type evt) : Image(evt, nullptr, 0, 0, 0, 0, 0, {}) { }
 
         const void* data_;  ///< pointer to the image data
         long long int tm_;  ///< timestamp
@@ -40,6 +72,17 @@ namespace event
         int bpp_ ;          ///< bits per pixel
         int size_;          ///< total size of the image
         QQuaternion imu_;   ///< latest imu position
+        double micronsPerPixel_;    ///< microns per pixel
+        double originX_;    ///< image origin in microns in the horizontal axis
+        double originY_;    ///< image origin in microns in the vertical axis
+        double angle_;      ///< acquisition angle for volumetric data
+        CusTgcInfo tgc_[CUS_MAXTGC];    ///< tgc points
+        bool overlay_;      ///< flag that the image is an overlay without grayscale
+        CusImageFormat format_;     ///< format the image was sent in
+        double fps_;        ///< acquisition frame rate
+        int frameWidth_;    ///< width of the image as transmitted, before cropping to the region of interest
+        int frameHeight_;   ///< height of the image as transmitted
+        int frameSize_;     ///< size of the image as transmitted
     };
 
     /// wrapper for new rf events that can be posted from the api callbacks
@@ -55,6 +98,8 @@ namespace event
         /// @param[in] lateral lateral spacing between lines
         /// @param[in] axial sample size
         RfImage(const void* data, long long int tm, int l, int s, int bps, int sz, double lateral, double axial) : Image(RF_EVENT, data, tm, l, s, bps, sz, {}), lateral_(lateral), axial_(axial) { }
+        /// constructs empty rf data to be filled in later
+        explicit RfImage(QEvent::Type) : RfImage(nullptr, 0, 0, 0, 0, 0, 0, 0) { }
 
         double lateral_;    ///< spacing between each line
         double axial_;      ///< sample size
@@ -79,17 +124,6 @@ namespace event
         bool pw_;                   ///< flag specifying the data is pw and not m
     };
 
-    /// wrapper for new imu data events that can be posted from the api callbacks
-    class Imu : public QEvent
-    {
-    public:
-        /// default constructor
-        /// @param[in] imu latest imu data
-        explicit Imu(const QQuaternion& imu) : QEvent(IMU_EVENT), imu_(imu) { }
-
-        QQuaternion imu_;   ///< latest imu position
-    };
-
     /// wrapper for freeze events that can be posted from the api callbacks
     class Freeze : public QEvent
     {
@@ -148,6 +182,11 @@ namespace event
     };
 }
 
+#include "slot.h"
+#include "stats.h"
+#include "roi.h"
+#include "subscription.h"
+
 /// holds raw data information
 class RawDataInfo
 {
@@ -162,6 +201,8 @@ public:
 
 class UltrasoundImage;
 class RfSignal;
+class TiledView;
+class ReconnectManager;
 
 /// caster gui application
 class Caster : public QMainWindow
@@ -172,13 +213,29 @@ public:
     explicit Caster(QWidget *parent = nullptr);
     ~Caster() override;
 
+    ImuBuffer& imu() { return *imu_; }
+    ImuBatcher& imuBatches() { return *imuBatches_; }
+    FrameSlot<event::Image>& images() { return images_; }
+    FrameSlot<event::Image>& overlays() { return overlays_; }
+    FrameSlot<event::Image>& prescanImages() { return prescanImages_; }
+    FrameSlot<event::RfImage>& rfData() { return rfData_; }
+    StreamStats& imageStats() { return imageStats_; }
+    StreamStats& prescanStats() { return prescanStats_; }
+    StreamStats& rfStats() { return rfStats_; }
+    StreamSubscription& subscription(Stream s) { return subscriptions_[static_cast<size_t>(s)]; }
+    RegionOfInterest& roi() { return roi_; }
+    ResolutionManager& resolution() { return *resolution_; }
+    FormatSelector& formatSelector() { return *format_; }
+
 protected:
     virtual bool event(QEvent *event) override;
     virtual void closeEvent(QCloseEvent *event) override;
 
 private:
-    void newProcessedImage(const void* img, int w, int h, int bpp, int sz, const QQuaternion& imu);
-    void newPrescanImage(const void* img, int w, int h, int bpp, int sz);
+    void newProcessedImage(const event::Image& evt);
+    void newPrescanImage(const void* img, int w, int h, int bpp, int sz, long long int tm, const CusTgcInfo* tgc, double micronsPerSample);
+    void trackMotion(QImage frame, long long int tm);
+    void motionTracked(bool tracked, const MotionField& field);
     void newRfData(const void* rfdata, int l, int s, int bps, double lateral, double axial);
     void newMSpectrum(const void* rfdata, int l, int s, int bps, double period, double micronsPerSample);
     void newPwSpectrum(const void* rfdata, int l, int s, int bps, double period, double velocityPerSample);
@@ -190,7 +247,7 @@ private:
     void rawData(int sz);
     void connected(int imagePort, int imuPort);
     void disconnected(bool res);
-    void newImuData(const QQuaternion& imu);
+    void newImuData(const ImuBatch& batch);
 
 public slots:
     void onConnect();
@@ -203,9 +260,18 @@ public slots:
     void onAddTrace();
     void onCaptureImage();
     void onClearScreen();
+    void onResetVolume();
+    void onSeparateOverlays(bool en);
+    void onCineSeek(int index);
+    void onCinePlay(bool en);
 
 private:
     void updateCaptureButtons();
+    void updateSkipped();
+    void updateStats();
+    void updateRoi();
+    void updateCine();
+    void playNextCineFrame();
     bool connected_;            ///< connection state
     bool frozen_;               ///< freeze state
     long long int lasttime_;    ///< timesetamp of last received frame
@@ -215,6 +281,41 @@ private:
     UltrasoundImage* image_;    ///< image display
     ProbeRender* render_;           ///< probe renderer
     RfSignal* signal_;          ///< rf signal display
+    TiledView* tiles_;          ///< tiled view of several streams
+    std::unique_ptr<ImuBuffer> imu_;            ///< imu history, fed from the api threads
+    std::unique_ptr<ImuBatcher> imuBatches_;    ///< streamed imu samples collected for the gui
+    std::unique_ptr<MotionEstimator> motion_;   ///< frame-to-frame motion estimation
+    std::unique_ptr<VolumeCompounder> volume_;  ///< freehand volume compounding
+    std::unique_ptr<TgcNormalizer> tgc_;        ///< tgc removal for quantitative intensities
+    std::unique_ptr<TgcNormalizer> prescanTgc_; ///< tgc removal for the pre-scan images, which have their own geometry
+    std::vector<uint8_t> normalized_;           ///< latest processed image with the tgc removed
+    std::vector<uint8_t> normalizedPrescan_;    ///< latest pre-scan image with the tgc removed
+    std::unique_ptr<OverlayCompositor> compositor_; ///< pairs separated overlays with their grayscale frames
+    std::unique_ptr<ResolutionManager> resolution_; ///< negotiates the output size with the scanner
+    std::unique_ptr<CineBuffer> cine_;          ///< recent frames kept for review while frozen
+    std::unique_ptr<FormatSelector> format_;    ///< adapts the stream format to the link quality
+    std::unique_ptr<ReconnectManager> reconnect_;   ///< restores dropped connections
+    QTimer cineTimer_;          ///< schedules cine playback at the original frame timing
+    FrameSlot<event::Image> images_;           ///< latest processed image
+    FrameSlot<event::Image> overlays_;         ///< latest separated overlay
+    FrameSlot<event::Image> prescanImages_;    ///< latest pre-scan converted image
+    FrameSlot<event::RfImage> rfData_;         ///< latest rf data
+    QLabel* skipped_;           ///< displays the # of frames skipped by the gui
+    StreamStats imageStats_;    ///< arrival statistics of the processed images
+    StreamStats prescanStats_;  ///< arrival statistics of the pre-scan converted images
+    StreamStats rfStats_;       ///< arrival statistics of the rf data
+    std::array<StreamSubscription, static_cast<size_t>(Stream::Count)> subscriptions_;  ///< delivery settings of each stream
+    RegionOfInterest roi_;      ///< part of the processed images that is delivered
+    StreamStats::Counters lastStats_;   ///< processed image counters at the previous update
+    QLabel* link_;              ///< displays the loss and jitter of the processed images
+    QTimer statsTimer_;         ///< periodically refreshes the link statistics
+    QElapsedTimer imuStream_;   ///< time since the latest streamed imu batch, invalid if none arrived
+    int volumeFrames_;          ///< # of frames compounded since the last slice update
+    QThreadPool motionThread_;  ///< runs the motion estimation off the gui thread
+    QImage motionPending_;      ///< latest frame received while an estimate was running
+    long long int motionPendingTm_; ///< timestamp of the pending frame
+    bool motionBusy_;           ///< flag that an estimate is running
+    bool motionReset_;          ///< flag to restart the tracking with the next frame
     QImage prescan_;            ///< pre-scan converted image
     QTimer imageTimer_;         ///< timer to warn the user about the firewall
     std::unique_ptr<QSettings> settings_;   ///< persistent settings
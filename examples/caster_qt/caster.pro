@@ -1,17 +1,23 @@
 TARGET = caster_qt
 TEMPLATE = app
-QT += core widgets gui 3dextras
+QT += core widgets gui 3dextras 3dlogic
 CONFIG += c++17 precompile_header
 DEFINES += QT_DEPRECATED_WARNINGS
 PRECOMPILED_HEADER = pch.h
 
+# use a gl viewport with a persistent image texture when available (software rasterizers are fine)
+qtHaveModule(openglwidgets) {
+    QT += opengl openglwidgets
+    DEFINES += CASTER_OPENGL
+}
+
 # ensure to unpack the appropriate libs from the zip file into this folder
 LIBPATH = $$PWD/../../lib
 INCLUDEPATH += $$PWD/../../include
 LIBS += -L$$LIBPATH/ -lcast
 
-SOURCES += main.cpp caster.cpp display.cpp 3d.cpp
-HEADERS += caster.h display.h 3d.h
+SOURCES += main.cpp caster.cpp cine.cpp compositor.cpp display.cpp format.cpp 3d.cpp imu.cpp lut.cpp motion.cpp parallel.cpp reconnect.cpp resolution.cpp roi.cpp stats.cpp subscription.cpp tgc.cpp tiles.cpp volume.cpp
+HEADERS += caster.h cine.h compositor.h display.h format.h 3d.h imu.h lut.h motion.h parallel.h reconnect.h resolution.h roi.h slot.h stats.h subscription.h tgc.h tiles.h volume.h
 FORMS += caster.ui
 
 RESOURCES += \
@@ -0,0 +1,90 @@
+#include "cine.h"
+#include <algorithm>
+#include <cstring>
+
+/// default constructor
+/// @param[in] budget the maximum # of bytes retained
+CineBuffer::CineBuffer(size_t budget) : budget_(budget), bytes_(0)
+{
+}
+
+/// sets the memory budget, evicting frames if needed
+/// @param[in] bytes the maximum # of bytes retained
+void CineBuffer::setBudget(size_t bytes)
+{
+    budget_ = bytes;
+    evict(0);
+}
+
+/// discards all frames
+void CineBuffer::clear()
+{
+    frames_.clear();
+    pool_.clear();
+    bytes_ = 0;
+}
+
+/// evicts the oldest frames until a new frame fits in the budget
+/// @param[in] incoming size of the new frame in bytes
+void CineBuffer::evict(size_t incoming)
+{
+    while (!frames_.empty() && bytes_ + incoming > budget_)
+    {
+        bytes_ -= frames_.front().data_.size();
+        // a single spare buffer is enough since frames are evicted and added one at a time in steady state
+        if (pool_.empty())
+            pool_.push_back(std::move(frames_.front().data_));
+        frames_.pop_front();
+    }
+}
+
+/// adds a new frame, evicting the oldest frames to stay within budget
+/// @param[in] data the image data
+/// @param[in] sz size of the image data in bytes
+/// @param[in] w the image width
+/// @param[in] h the image height
+/// @param[in] bpp bits per pixel
+/// @param[in] tm the frame timestamp
+/// @param[in] imu the orientation at the time of the frame
+void CineBuffer::add(const void* data, int sz, int w, int h, int bpp, long long int tm, const QQuaternion& imu)
+{
+    if (!data || sz <= 0 || static_cast<size_t>(sz) > budget_)
+        return;
+
+    // frames arriving out of order, or after the clock restarted, start a new loop
+    if (!frames_.empty() && tm <= frames_.back().tm_)
+        clear();
+
+    evict(sz);
+    CineFrame f;
+    if (!pool_.empty())
+    {
+        f.data_ = std::move(pool_.back());
+        pool_.pop_back();
+    }
+    f.data_.resize(sz);
+    std::memcpy(f.data_.data(), data, sz);
+    f.tm_ = tm;
+    f.width_ = w;
+    f.height_ = h;
+    f.bpp_ = bpp;
+    f.imu_ = imu;
+    bytes_ += f.data_.size();
+    frames_.push_back(std::move(f));
+}
+
+/// finds the frame displayed at a given time
+/// @param[in] tm the timestamp
+/// @return index of the latest frame at or before the timestamp, -1 if there is none
+int CineBuffer::indexAt(long long int tm) const
+{
+    auto it = std::upper_bound(frames_.begin(), frames_.end(), tm, [](long long int t, const CineFrame& f) { return t < f.tm_; });
+    return static_cast<int>(it - frames_.begin()) - 1;
+}
+
+/// retrieves the time span of the retained frames
+/// @return the duration in seconds
+double CineBuffer::duration() const
+{
+    return frames_.size() > 1 ? static_cast<double>(frames_.back().tm_ - frames_.front().tm_) / 1e9 : 0.0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+/// locally retained processed frame
+struct CineFrame
+{
+    long long int tm_;      ///< timestamp in nanoseconds
+    int width_;             ///< image width
+    int height_;            ///< image height
+    int bpp_;               ///< bits per pixel
+    QQuaternion imu_;       ///< orientation at the time of the frame
+    std::vector<char> data_;    ///< image data as received
+};
+
+/// bounded ring of the most recent processed frames
+/// @details frames are kept as received so compressed streams stay small, the oldest frames are evicted once the
+///          memory budget is exceeded and their buffers are reused for new frames. frames are addressed by index from
+///          the oldest retained frame, which takes constant time
+class CineBuffer
+{
+public:
+    explicit CineBuffer(size_t budget = 256 * 1024 * 1024);
+
+    void setBudget(size_t bytes);
+    size_t budget() const { return budget_; }
+    size_t bytes() const { return bytes_; }
+    int size() const { return static_cast<int>(frames_.size()); }
+    bool empty() const { return frames_.empty(); }
+    void clear();
+    void add(const void* data, int sz, int w, int h, int bpp, long long int tm, const QQuaternion& imu);
+    const CineFrame& frame(int index) const { return frames_[index]; }
+    int indexAt(long long int tm) const;
+    double duration() const;
+
+private:
+    void evict(size_t incoming);
+
+private:
+    std::deque<CineFrame> frames_;  ///< retained frames, oldest first
+    std::vector<std::vector<char>> pool_;   ///< buffers of evicted frames
+    size_t budget_;                 ///< maximum # of bytes retained
+    size_t bytes_;                  ///< # of bytes currently retained
+};
@@ -0,0 +1,249 @@
+#include "compositor.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define COMPOSITOR_SSE2
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define COMPOSITOR_NEON
+#endif
+
+/// default constructor
+/// @param[in] window the maximum # of frames held while waiting for a partner
+OverlayCompositor::OverlayCompositor(int window) : window_(std::max(window, 1)), sinceOverlay_(window_)
+{
+}
+
+/// sets the reorder window
+/// @param[in] frames the maximum # of frames held while waiting for a partner
+void OverlayCompositor::setWindow(int frames)
+{
+    window_ = std::max(frames, 1);
+}
+
+/// discards all buffered frames
+void OverlayCompositor::clear()
+{
+    for (auto& l : gray_)
+        release(l);
+    for (auto& l : overlays_)
+        release(l);
+    for (auto& p : ready_)
+    {
+        release(p.first);
+        release(p.second);
+    }
+    gray_.clear();
+    overlays_.clear();
+    ready_.clear();
+    sinceOverlay_ = window_;
+}
+
+/// copies a frame into a recycled buffer
+/// @param[in] data the argb pixels
+/// @param[in] w width in pixels
+/// @param[in] h height in pixels
+/// @param[in] tm timestamp
+/// @return the layer
+OverlayCompositor::Layer OverlayCompositor::acquire(const void* data, int w, int h, long long int tm)
+{
+    Layer l{ tm, w, h, {} };
+    if (!pool_.empty())
+    {
+        l.data_ = std::move(pool_.back());
+        pool_.pop_back();
+    }
+    l.data_.resize(static_cast<size_t>(w) * h * 4);
+    std::memcpy(l.data_.data(), data, l.data_.size());
+    return l;
+}
+
+/// returns a layer's buffer to the pool
+/// @param[in,out] layer the layer
+void OverlayCompositor::release(Layer& layer)
+{
+    if (layer.data_.capacity())
+        pool_.push_back(std::move(layer.data_));
+    layer.data_.clear();
+}
+
+/// hands out all waiting grayscale frames without an overlay, keeping them in order
+void OverlayCompositor::flush()
+{
+    for (auto& l : gray_)
+        ready_.emplace_back(std::move(l), Layer{ l.tm_, 0, 0, {} });
+    gray_.clear();
+}
+
+/// adds a new frame
+/// @param[in] data the argb pixels
+/// @param[in] w width in pixels
+/// @param[in] h height in pixels
+/// @param[in] tm timestamp of the frame
+/// @param[in] overlay flag that the frame is an overlay
+/// @return true if at least one pair is ready to be taken
+bool OverlayCompositor::add(const void* data, int w, int h, long long int tm, bool overlay)
+{
+    if (!data || w <= 0 || h <= 0)
+        return !ready_.empty();
+
+    auto& mine = overlay ? overlays_ : gray_;
+    auto& other = overlay ? gray_ : overlays_;
+
+    auto match = std::find_if(other.begin(), other.end(), [&](const Layer& l)
+    {
+        return l.tm_ == tm && l.width_ == w && l.height_ == h;
+    });
+    if (match != other.end())
+    {
+        // frames older than the match lost their partner, grayscale frames are still shown on their own
+        for (auto it = other.begin(); it != match; ++it)
+        {
+            if (overlay)
+                ready_.emplace_back(std::move(*it), Layer{ it->tm_, 0, 0, {} });
+            else
+                release(*it);
+        }
+        if (!overlay)
+            flush();
+        Layer partner = std::move(*match);
+        other.erase(other.begin(), match + 1);
+        Layer layer = acquire(data, w, h, tm);
+        if (overlay)
+            ready_.emplace_back(std::move(partner), std::move(layer));
+        else
+            ready_.emplace_back(std::move(layer), std::move(partner));
+        if (overlay)
+            sinceOverlay_ = 0;
+        return true;
+    }
+
+    if (overlay)
+    {
+        sinceOverlay_ = 0;
+        mine.push_back(acquire(data, w, h, tm));
+        while (static_cast<int>(mine.size()) > window_)
+        {
+            release(mine.front());
+            mine.pop_front();
+        }
+    }
+    else
+    {
+        // without recent overlays there is nothing to wait for
+        if (++sinceOverlay_ > window_)
+        {
+            flush();
+            ready_.emplace_back(acquire(data, w, h, tm), Layer{ tm, 0, 0, {} });
+        }
+        else
+        {
+            mine.push_back(acquire(data, w, h, tm));
+            while (static_cast<int>(mine.size()) > window_)
+            {
+                ready_.emplace_back(std::move(mine.front()), Layer{ mine.front().tm_, 0, 0, {} });
+                mine.pop_front();
+            }
+        }
+    }
+
+    return !ready_.empty();
+}
+
+/// takes the oldest completed pair
+/// @param[out] frame the pair, the layers remain valid until the next call
+/// @return true if a pair was available
+bool OverlayCompositor::take(CompositeFrame& frame)
+{
+    release(current_.first);
+    release(current_.second);
+    if (ready_.empty())
+        return false;
+
+    current_ = std::move(ready_.front());
+    ready_.pop_front();
+    frame.tm_ = current_.first.tm_;
+    frame.width_ = current_.first.width_;
+    frame.height_ = current_.first.height_;
+    frame.gray_ = current_.first.data_.data();
+    frame.overlay_ = current_.second.data_.empty() ? nullptr : current_.second.data_.data();
+    return true;
+}
+
+/// blends a pair into a caller owned buffer
+/// @param[in] frame the pair
+/// @param[out] out the destination argb buffer, must hold the height of the frame at the given stride
+/// @param[in] stride bytes per row of the destination
+void OverlayCompositor::composite(const CompositeFrame& frame, uint8_t* out, int stride)
+{
+    const int row = frame.width_ * 4;
+    for (auto y = 0; y < frame.height_; y++)
+    {
+        uint8_t* dst = out + y * stride;
+        const uint8_t* g = frame.gray_ + y * row;
+        if (frame.overlay_)
+            blend(g, frame.overlay_ + y * row, dst, frame.width_);
+        else if (dst != g)
+            std::memcpy(dst, g, row);
+    }
+}
+
+/// alpha blends an overlay over a grayscale image
+/// @param[in] gray the grayscale argb pixels
+/// @param[in] overlay the overlay argb pixels, non-premultiplied
+/// @param[out] out the blended argb pixels, fully opaque, may alias gray
+/// @param[in] pixels # of pixels
+void OverlayCompositor::blend(const uint8_t* gray, const uint8_t* overlay, uint8_t* out, int pixels)
+{
+    int i = 0;
+#if defined(COMPOSITOR_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    // blends two pixels held as 16 bit lanes: (o * a + g * (255 - a) + 128) / 255
+    auto blend2 = [&](__m128i g, __m128i o)
+    {
+        __m128i a = _mm_shufflelo_epi16(o, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(o, a), _mm_mullo_epi16(g, _mm_sub_epi16(full, a))), round);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+    for (; i + 4 <= pixels; i += 4)
+    {
+        const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + i * 4));
+        const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(overlay + i * 4));
+        const __m128i lo = blend2(_mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(o, zero));
+        const __m128i hi = blend2(_mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(o, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+#elif defined(COMPOSITOR_NEON)
+    for (; i + 16 <= pixels; i += 16)
+    {
+        const uint8x16x4_t g = vld4q_u8(gray + i * 4);
+        const uint8x16x4_t o = vld4q_u8(overlay + i * 4);
+        const uint8x16_t a = o.val[3], ia = vmvnq_u8(a);
+        uint8x16x4_t r;
+        for (auto c = 0; c < 3; c++)
+        {
+            const uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(o.val[c]), vget_low_u8(a)), vget_low_u8(g.val[c]), vget_low_u8(ia));
+            const uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(o.val[c]), vget_high_u8(a)), vget_high_u8(g.val[c]), vget_high_u8(ia));
+            r.val[c] = vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)), vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+        }
+        r.val[3] = vdupq_n_u8(255);
+        vst4q_u8(out + i * 4, r);
+    }
+#endif
+    for (; i < pixels; i++)
+    {
+        const int a = overlay[i * 4 + 3];
+        for (auto c = 0; c < 3; c++)
+        {
+            const int x = overlay[i * 4 + c] * a + gray[i * 4 + c] * (255 - a) + 128;
+            out[i * 4 + c] = static_cast<uint8_t>((x + (x >> 8)) >> 8);
+        }
+        out[i * 4 + 3] = 255;
+    }
+}
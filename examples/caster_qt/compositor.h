@@ -0,0 +1,55 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+/// grayscale frame paired with its overlay
+struct CompositeFrame
+{
+    long long int tm_;          ///< timestamp shared by both layers
+    int width_;                 ///< width of the layers in pixels
+    int height_;                ///< height of the layers in pixels
+    const uint8_t* gray_;       ///< grayscale layer (argb)
+    const uint8_t* overlay_;    ///< overlay layer (argb), null if there was no matching overlay
+};
+
+/// pairs separated grayscale and overlay frames and composites them
+/// @details when overlays are separated with castSeparateOverlays, the grayscale frame and its color doppler or
+///          strain overlay arrive as two frames with the same timestamp. frames are held in a small reorder window until
+///          their partner arrives, then handed out as a pair that can either be blended with simd into a caller owned
+///          buffer or displayed as two layers so that no blending happens on the cpu
+/// @note only uncompressed argb frames are supported
+class OverlayCompositor
+{
+public:
+    explicit OverlayCompositor(int window = 4);
+
+    void setWindow(int frames);
+    void clear();
+    bool add(const void* data, int w, int h, long long int tm, bool overlay);
+    bool take(CompositeFrame& frame);
+    static void composite(const CompositeFrame& frame, uint8_t* out, int stride);
+    static void blend(const uint8_t* gray, const uint8_t* overlay, uint8_t* out, int pixels);
+
+private:
+    /// buffered layer
+    struct Layer
+    {
+        long long int tm_;  ///< timestamp
+        int width_;         ///< width in pixels
+        int height_;        ///< height in pixels
+        std::vector<uint8_t> data_; ///< argb pixels
+    };
+
+    Layer acquire(const void* data, int w, int h, long long int tm);
+    void release(Layer& layer);
+    void flush();
+
+    int window_;                    ///< maximum # of frames held while waiting for a partner
+    int sinceOverlay_;              ///< # of grayscale frames since the last overlay, overlays are inactive past the window
+    std::deque<Layer> gray_;        ///< grayscale frames waiting for an overlay
+    std::deque<Layer> overlays_;    ///< overlays waiting for a grayscale frame
+    std::deque<std::pair<Layer, Layer>> ready_; ///< completed pairs, the overlay is empty if it never arrived
+    std::pair<Layer, Layer> current_;   ///< pair handed out by the last call to take
+    std::vector<std::vector<uint8_t>> pool_;    ///< recycled layer buffers
+};
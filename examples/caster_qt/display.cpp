@@ -1,5 +1,14 @@
 #include "display.h"
 #include <cast/cast.h>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define DISPLAY_SSE2
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define DISPLAY_NEON
+#endif
 
 namespace
 {
@@ -8,11 +17,76 @@ namespace
         front,
         back
     };
+
+    /// # of frames kept in the rf waterfall
+    const int kWaterfallLines = 512;
+    /// maximum # of depth bins in the rf waterfall
+    const int kWaterfallRows = 256;
+
+    /// finds the extents of a run of rf samples
+    /// @param[in] data the samples
+    /// @param[in] n # of samples, must be at least 1
+    /// @param[out] lo the minimum sample
+    /// @param[out] hi the maximum sample
+    void minMax(const int16_t* data, int n, int16_t& lo, int16_t& hi)
+    {
+        int16_t mn = data[0], mx = data[0];
+        int i = 0;
+#if defined(DISPLAY_SSE2)
+        if (n >= 8)
+        {
+            __m128i vmn = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            __m128i vmx = vmn;
+            for (i = 8; i + 8 <= n; i += 8)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                vmn = _mm_min_epi16(vmn, v);
+                vmx = _mm_max_epi16(vmx, v);
+            }
+            // fold the 8 lanes down to one
+            vmn = _mm_min_epi16(vmn, _mm_shuffle_epi32(vmn, _MM_SHUFFLE(1, 0, 3, 2)));
+            vmx = _mm_max_epi16(vmx, _mm_shuffle_epi32(vmx, _MM_SHUFFLE(1, 0, 3, 2)));
+            vmn = _mm_min_epi16(vmn, _mm_shuffle_epi32(vmn, _MM_SHUFFLE(2, 3, 0, 1)));
+            vmx = _mm_max_epi16(vmx, _mm_shuffle_epi32(vmx, _MM_SHUFFLE(2, 3, 0, 1)));
+            vmn = _mm_min_epi16(vmn, _mm_srli_epi32(vmn, 16));
+            vmx = _mm_max_epi16(vmx, _mm_srli_epi32(vmx, 16));
+            mn = static_cast<int16_t>(_mm_cvtsi128_si32(vmn));
+            mx = static_cast<int16_t>(_mm_cvtsi128_si32(vmx));
+        }
+#elif defined(DISPLAY_NEON)
+        if (n >= 8)
+        {
+            int16x8_t vmn = vld1q_s16(data);
+            int16x8_t vmx = vmn;
+            for (i = 8; i + 8 <= n; i += 8)
+            {
+                int16x8_t v = vld1q_s16(data + i);
+                vmn = vminq_s16(vmn, v);
+                vmx = vmaxq_s16(vmx, v);
+            }
+            int16x4_t pmn = vpmin_s16(vget_low_s16(vmn), vget_high_s16(vmn));
+            int16x4_t pmx = vpmax_s16(vget_low_s16(vmx), vget_high_s16(vmx));
+            pmn = vpmin_s16(pmn, pmn);
+            pmx = vpmax_s16(pmx, pmx);
+            pmn = vpmin_s16(pmn, pmn);
+            pmx = vpmax_s16(pmx, pmx);
+            mn = vget_lane_s16(pmn, 0);
+            mx = vget_lane_s16(pmx, 0);
+        }
+#endif
+        for (; i < n; i++)
+        {
+            mn = std::min(mn, data[i]);
+            mx = std::max(mx, data[i]);
+        }
+        lo = mn;
+        hi = mx;
+    }
 }
 
 /// default constructor
 /// @param[in] parent the parent object
-UltrasoundImage::UltrasoundImage(QWidget* parent) : QGraphicsView(parent), noImage_(false)
+UltrasoundImage::UltrasoundImage(QWidget* parent) : QGraphicsView(parent), noImage_(false), imageDirty_(true), hasOverlay_(false)
 {
     QGraphicsScene* sc = new QGraphicsScene(this);
     setScene(sc);
@@ -21,15 +95,39 @@ UltrasoundImage::UltrasoundImage(QWidget* parent) : QGraphicsView(parent), noIma
     image_ = QImage(320, 240, QImage::Format_ARGB32);
     image_.fill(Qt::black);
     setSceneRect(0, 0, image_.width(), image_.height());
+#ifdef CASTER_OPENGL
+    // frames are uploaded into a persistent texture, a gl viewport always repaints fully
+    setViewport(new QOpenGLWidget(this));
     setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+#else
+    // moving overlay items only repaints the area around them, new frames invalidate the whole background
+    setViewportUpdateMode(QGraphicsView::SmartViewportUpdate);
+#endif
 
     overlayColor_ = QColor(255, 127, 80, 100);
+    resetOverlay();
 
     QSizePolicy p(QSizePolicy::Preferred, QSizePolicy::Preferred);
     p.setHeightForWidth(true);
     setSizePolicy(p);
 }
 
+/// destructor
+UltrasoundImage::~UltrasoundImage()
+{
+#ifdef CASTER_OPENGL
+    // gl resources have to be released with their context current
+    auto gl = qobject_cast<QOpenGLWidget*>(viewport());
+    if (gl && texture_)
+    {
+        gl->makeCurrent();
+        texture_.reset();
+        blitter_.destroy();
+        gl->doneCurrent();
+    }
+#endif
+}
+
 /// loads a new image from raw data
 /// @param[in] img the new image data
 /// @param[in] w the image width
@@ -38,22 +136,97 @@ UltrasoundImage::UltrasoundImage(QWidget* parent) : QGraphicsView(parent), noIma
 /// @param[in] sz size of image in bytes
 void UltrasoundImage::loadImage(const void* img, int w, int h, int bpp, int sz)
 {
-    // check for size match
-    if (image_.width() != w || image_.height() != h)
-        return;
+    // the output size is negotiated separately from the view size, so the image follows whatever is received
+    setImageSize(w, h);
 
     // set the image data
+    // 8 bit frames are mapped to argb on the client, so display adjustments do not need new frames
+    if (bpp == 8 && sz == w * h)
+    {
+        gray_.assign(static_cast<const uchar*>(img), static_cast<const uchar*>(img) + sz);
+        lut_.apply(gray_.data(), w, h, w, reinterpret_cast<uint32_t*>(image_.bits()), static_cast<int>(image_.bytesPerLine()));
+    }
     // check that the size matches the dimensions (uncompressed)
-    if (sz == (w * h * (bpp / 8)))
+    else if (sz == (w * h * (bpp / 8)))
+    {
+        gray_.clear();
         std::memcpy(image_.bits(), img, w * h * (bpp / 8));
-    // try to load jpeg
+    }
+    // try to load jpeg or png
     else
-        image_.loadFromData(static_cast<const uchar*>(img), sz, "JPG");
+    {
+        gray_.clear();
+        image_.loadFromData(static_cast<const uchar*>(img), sz);
+        if (image_.format() != QImage::Format_ARGB32 && image_.format() != QImage::Format_RGB32)
+            image_ = image_.convertToFormat(QImage::Format_ARGB32);
+    }
 
     // redraw
+    refresh();
+}
+
+/// reapplies the display mapping to the latest 8 bit frame, used when the mapping changes while frozen
+void UltrasoundImage::applyLut()
+{
+    if (gray_.size() != static_cast<size_t>(image_.width()) * image_.height())
+        return;
+
+    lut_.apply(gray_.data(), image_.width(), image_.height(), image_.width(), reinterpret_cast<uint32_t*>(image_.bits()), static_cast<int>(image_.bytesPerLine()));
+    refresh();
+}
+
+/// resizes the image buffer to the received frame size, the view scales it to fit
+/// @param[in] w the image width
+/// @param[in] h the image height
+void UltrasoundImage::setImageSize(int w, int h)
+{
+    if (w <= 0 || h <= 0 || (image_.width() == w && image_.height() == h))
+        return;
+
+    image_ = QImage(w, h, QImage::Format_ARGB32);
+    image_.fill(Qt::black);
+    imageDirty_ = true;
+}
+
+/// retrieves the mapping from view coordinates to image coordinates
+/// @return the transform, identity when the image matches the view
+QTransform UltrasoundImage::toImage() const
+{
+    const QRectF r = sceneRect();
+    if (r.isEmpty() || image_.isNull())
+        return QTransform();
+    return QTransform::fromScale(image_.width() / r.width(), image_.height() / r.height());
+}
+
+/// loads a separated overlay that is drawn on top of the image
+/// @param[in] img the argb overlay data, null to clear the overlay
+/// @param[in] w the overlay width
+/// @param[in] h the overlay height
+void UltrasoundImage::loadOverlay(const void* img, int w, int h)
+{
+    if (!img)
+    {
+        if (!layer_.isNull())
+        {
+            layer_ = QImage();
+            scene()->invalidate();
+        }
+        return;
+    }
+
+    if (layer_.width() != w || layer_.height() != h)
+        layer_ = QImage(w, h, QImage::Format_ARGB32);
+    std::memcpy(layer_.bits(), img, w * h * 4);
     scene()->invalidate();
 }
 
+/// redraws the image after its buffer was modified in place
+void UltrasoundImage::refresh()
+{
+    imageDirty_ = true;
+    scene()->invalidate(sceneRect(), QGraphicsScene::BackgroundLayer);
+}
+
 namespace
 {
     QGraphicsItem* createLabel(const QString& text, QGraphicsScene* scenePtr, const QPointF& startPos)
@@ -76,67 +249,24 @@ namespace
     class CaliperItem : public QGraphicsRectItem
     {
     public:
-        CaliperItem(const QRectF& rect, AddTo addto, std::shared_ptr<PointList> trace)
+        CaliperItem(const QRectF& rect, AddTo addto, TraceItem* trace)
             : QGraphicsRectItem(rect)
             , addto_{addto}
-            , trace_{std::move(trace)}
+            , trace_{trace}
         {}
     protected:
         virtual QVariant itemChange(QGraphicsItem::GraphicsItemChange change, const QVariant& value) override
         {
             const QVariant result = QGraphicsRectItem::itemChange(change, value);
-            if (change != QGraphicsItem::ItemPositionHasChanged)
-                return result;
-
-            const QPointF center = getCenterPos(this);
-            QGraphicsItem* compareNearest = nullptr;
-            QPointF pointNearest;
-            if (!trace_->empty())
-            {
-                compareNearest = (addto_ == AddTo::front ? trace_->front() : trace_->back());
-                pointNearest = getCenterPos(compareNearest);
-            }
-            QGraphicsScene* scenePtr = scene();
-            if (trace_->size() > 1)
-            {
-                QGraphicsItem* compareNext = (addto_ == AddTo::front ? trace_->at(1) : trace_->at(trace_->size() - 2));
-                const QPointF pointNext = getCenterPos(compareNext);
-                if (QLineF(center, pointNext).length() < 20.0 &&
-                    QLineF(center, pointNearest).length() < 20.0)
-                {
-                    scenePtr->removeItem(compareNearest);
-                    delete compareNearest;
-                    compareNearest = nullptr;
-                    if (addto_ == AddTo::front)
-                    {
-                        trace_->pop_front();
-                    }
-                    else
-                    {
-                        trace_->pop_back();
-                    }
-                    return result;
-                }
-            }
-            if (compareNearest && QLineF(center, pointNearest).length() < 20.0)
-                return result;
-            QGraphicsItem* newItem = scenePtr->addRect(QRectF(center - QPointF(1.0, 1.0), QSizeF(2.0, 2.0)), QPen(QColor(0, 255, 0)), QBrush(QColor(0, 255, 0)));
-            if (addto_ == AddTo::front)
-            {
-                trace_->push_front(newItem);
-            }
-            else
-            {
-                trace_->push_back(newItem);
-            }
-            scenePtr->invalidate();
+            if (change == QGraphicsItem::ItemPositionHasChanged)
+                trace_->moveEnd(getCenterPos(this), addto_ == AddTo::front);
             return result;
         }
     private:
         AddTo addto_;
-        std::shared_ptr<PointList> trace_;
+        TraceItem* trace_;
     };
-    QGraphicsRectItem* createCaliper(QGraphicsScene* scenePtr, const QSizeF& mainSize, AddTo addto, std::shared_ptr<PointList> trace)
+    QGraphicsRectItem* createCaliper(QGraphicsScene* scenePtr, const QSizeF& mainSize, AddTo addto, TraceItem* trace)
     {
         const qreal height = qMin(mainSize.height(), mainSize.width()) / 10.0;
         const QPointF startPos(mainSize.width() / 2.0, mainSize.height() / 2.0);
@@ -165,6 +295,183 @@ namespace
     }
 }
 
+namespace
+{
+    /// minimum distance between trace points
+    const qreal kTraceSpacing = 20.0;
+    /// maximum deviation of a point from a straight line for it to be merged into the line
+    const qreal kTraceTolerance = 1.0;
+
+    /// calculates the distance of a point to a segment
+    /// @param[in] pt the point
+    /// @param[in] a the start of the segment
+    /// @param[in] b the end of the segment
+    /// @return the distance
+    qreal segmentDistance(const QPointF& pt, const QPointF& a, const QPointF& b)
+    {
+        const QPointF ab = b - a;
+        const qreal len = QPointF::dotProduct(ab, ab);
+        const qreal t = (len > 0) ? qBound(0.0, QPointF::dotProduct(pt - a, ab) / len, 1.0) : 0.0;
+        return QLineF(pt, a + ab * t).length();
+    }
+
+    /// calculates the distance of a point to an infinite line
+    /// @param[in] pt the point
+    /// @param[in] a a point on the line
+    /// @param[in] b another point on the line
+    /// @return the distance
+    qreal lineDistance(const QPointF& pt, const QPointF& a, const QPointF& b)
+    {
+        const QPointF ab = b - a;
+        const qreal len = std::sqrt(QPointF::dotProduct(ab, ab));
+        if (len <= 0)
+            return QLineF(pt, a).length();
+        return std::abs(ab.x() * (pt.y() - a.y()) - ab.y() * (pt.x() - a.x())) / len;
+    }
+}
+
+/// default constructor
+TraceItem::TraceItem() : length_(0), cross_(0), boundsDirty_(false)
+{
+    // drawn below the calipers so they stay easy to grab
+    setZValue(-1);
+}
+
+/// adds a point to one end and updates the running sums
+/// @param[in] pt the new point
+/// @param[in] front flag to add to the front instead of the back
+void TraceItem::push(const QPointF& pt, bool front)
+{
+    prepareGeometryChange();
+    if (!points_.empty())
+    {
+        const QPointF& a = front ? pt : points_.back();
+        const QPointF& b = front ? points_.front() : pt;
+        length_ += QLineF(a, b).length();
+        cross_ += a.x() * b.y() - b.x() * a.y();
+    }
+    if (front)
+        points_.push_front(pt);
+    else
+        points_.push_back(pt);
+
+    if (!boundsDirty_)
+        bounds_ = (points_.size() == 1) ? QRectF(pt, QSizeF(0, 0)) : bounds_.united(QRectF(pt, QSizeF(0, 0)));
+}
+
+/// removes the point at one end and updates the running sums
+/// @param[in] front flag to remove from the front instead of the back
+void TraceItem::pop(bool front)
+{
+    prepareGeometryChange();
+    if (points_.size() > 1)
+    {
+        const QPointF& a = front ? points_[0] : points_[points_.size() - 2];
+        const QPointF& b = front ? points_[1] : points_.back();
+        length_ -= QLineF(a, b).length();
+        cross_ -= a.x() * b.y() - b.x() * a.y();
+    }
+    if (front)
+        points_.pop_front();
+    else
+        points_.pop_back();
+
+    if (points_.empty())
+    {
+        length_ = cross_ = 0;
+        bounds_ = QRectF();
+        boundsDirty_ = false;
+    }
+    else
+        boundsDirty_ = true;
+}
+
+/// follows a caliper with one end of the trace
+/// @param[in] pt the caliper position
+/// @param[in] front flag that the caliper is at the front of the trace
+void TraceItem::moveEnd(const QPointF& pt, bool front)
+{
+    if (points_.empty())
+    {
+        push(pt, front);
+        update();
+        return;
+    }
+
+    const size_t n = points_.size();
+    const QPointF nearest = front ? points_[0] : points_[n - 1];
+    if (n > 1)
+    {
+        const QPointF next = front ? points_[1] : points_[n - 2];
+        // moving back over the last segment shortens it, or removes it once the previous point is reached
+        if (segmentDistance(pt, next, nearest) < kTraceSpacing)
+        {
+            if (QLineF(pt, next).length() < kTraceSpacing)
+                pop(front);
+            else if (QLineF(pt, nearest).length() >= kTraceSpacing)
+            {
+                pop(front);
+                push(pt, front);
+            }
+            update();
+            return;
+        }
+    }
+
+    if (QLineF(pt, nearest).length() < kTraceSpacing)
+        return;
+
+    // a point continuing in a straight line replaces the end point rather than adding to the trace
+    if (n > 1 && lineDistance(nearest, front ? points_[1] : points_[n - 2], pt) < kTraceTolerance)
+        pop(front);
+    push(pt, front);
+    update();
+}
+
+/// retrieves the bounding box of the trace
+/// @return the bounding box, recalculated only after points were removed
+QRectF TraceItem::boundingRect() const
+{
+    if (boundsDirty_)
+    {
+        bounds_ = QRectF();
+        if (!points_.empty())
+        {
+            qreal x0 = points_.front().x(), x1 = x0, y0 = points_.front().y(), y1 = y0;
+            for (const QPointF& pt : points_)
+            {
+                x0 = std::min(x0, pt.x());
+                x1 = std::max(x1, pt.x());
+                y0 = std::min(y0, pt.y());
+                y1 = std::max(y1, pt.y());
+            }
+            bounds_ = QRectF(QPointF(x0, y0), QPointF(x1, y1));
+        }
+        boundsDirty_ = false;
+    }
+    // room for the pen
+    return bounds_.adjusted(-2, -2, 2, 2);
+}
+
+/// draws the trace as one polyline
+/// @param[in] painter the drawing context
+/// @param[in] option style options
+/// @param[in] widget the widget being drawn on
+void TraceItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    Q_UNUSED(option)
+    Q_UNUSED(widget)
+    if (points_.empty())
+        return;
+
+    QPolygonF line;
+    line.reserve(static_cast<qsizetype>(points_.size()));
+    for (const QPointF& pt : points_)
+        line << pt;
+    painter->setPen(QPen(QColor(0, 255, 0), 2));
+    painter->drawPolyline(line);
+}
+
 void UltrasoundImage::addLabel(const QString& text)
 {
     const QSizeF mainSize = sceneRect().size();
@@ -179,9 +486,10 @@ void UltrasoundImage::addTrace(const QString& text)
 {
     Q_UNUSED(text)
     Trace trace;
-    trace.points_ = std::make_shared<PointList>();
-    const QSizeF mainSize = sceneRect().size();
     QGraphicsScene* scenePtr = scene();
+    trace.points_ = new TraceItem;
+    scenePtr->addItem(trace.points_);
+    const QSizeF mainSize = sceneRect().size();
     trace.first_ = createCaliper(scenePtr, mainSize, AddTo::front, trace.points_);
     trace.second_ = createCaliper(scenePtr, mainSize, AddTo::back, trace.points_);
     trace.text_ = text;
@@ -215,33 +523,74 @@ std::vector<TraceInfo> UltrasoundImage::getTraces() const
     std::vector<TraceInfo> result;
     for (const Trace& trace : traces_)
     {
+        const std::deque<QPointF>& inner = trace.points_->points();
+        const QPointF first = getCenterPos(trace.first_), second = getCenterPos(trace.second_);
         QPolygonF points;
-        points << getCenterPos(trace.first_);
-        for (QGraphicsItem* pointItem : *trace.points_)
+        points.reserve(static_cast<qsizetype>(inner.size()) + 2);
+        points << first;
+        for (const QPointF& pt : inner)
+            points << pt;
+        points << second;
+
+        // only the segments to the calipers are not part of the running sums
+        double length = trace.points_->length(), cross = trace.points_->cross();
+        if (!inner.empty())
         {
-            points << getCenterPos(pointItem);
+            length += QLineF(first, inner.front()).length() + QLineF(inner.back(), second).length();
+            cross += (first.x() * inner.front().y() - inner.front().x() * first.y()) + (inner.back().x() * second.y() - second.x() * inner.back().y());
         }
-        points << getCenterPos(trace.second_);
-        result.emplace_back(trace.text_, points);
+        else
+        {
+            length += QLineF(first, second).length();
+            cross += first.x() * second.y() - second.x() * first.y();
+        }
+        // closing the polygon back to the first caliper
+        cross += second.x() * first.y() - first.x() * second.y();
+        result.emplace_back(trace.text_, points, length, std::abs(cross) / 2.0);
     }
     return result;
 }
 
-QImage UltrasoundImage::overlayImage() const
+/// clears the user overlay and sizes it to the image
+/// @details the mask rows are packed without padding so the buffer can be handed to castAddImageOverlay as is
+void UltrasoundImage::resetOverlay()
 {
-    if (overlay_.isEmpty() || image_.size().isNull())
-        return QImage{};
+    const int w = static_cast<int>(sceneRect().width()), h = static_cast<int>(sceneRect().height());
+    maskData_.assign(static_cast<size_t>(w) * h, 0);
+    mask_ = QImage(maskData_.data(), w, h, w, QImage::Format_Grayscale8);
+    overlayLayer_ = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
+    overlayLayer_.fill(Qt::transparent);
+    hasOverlay_ = false;
+}
 
-    QImage result(image_.size(), QImage::Format_Grayscale8);
-    result.fill(Qt::black);
+/// rasterizes a new segment of the user overlay into the mask and the display layer
+/// @param[in] from the start of the segment
+/// @param[in] to the end of the segment
+void UltrasoundImage::addStroke(const QPoint& from, const QPoint& to)
+{
+    const int width = 20;
     QPen pen(Qt::white);
-    pen.setWidth(20);
+    pen.setWidth(width);
     pen.setCapStyle(Qt::RoundCap);
     pen.setJoinStyle(Qt::RoundJoin);
-    QPainter painter(&result);
-    painter.setPen(pen);
-    painter.drawPath(overlay_);
-    return result;
+    {
+        QPainter mask(&mask_);
+        mask.setPen(pen);
+        mask.drawLine(from, to);
+    }
+    {
+        QColor overlayColor(overlayColor_);
+        overlayColor.setAlpha(255);
+        pen.setColor(overlayColor);
+        QPainter layer(&overlayLayer_);
+        layer.setPen(pen);
+        layer.drawLine(from, to);
+    }
+    hasOverlay_ = true;
+
+    // only the area around the new segment needs to be redrawn
+    const QRectF dirty = QRectF(from, to).normalized().adjusted(-width, -width, width, width);
+    scene()->invalidate(dirty, QGraphicsScene::BackgroundLayer);
 }
 
 void UltrasoundImage::clearOverlays()
@@ -257,11 +606,13 @@ void UltrasoundImage::clearOverlays()
     {
         scenePtr->removeItem(trace.first_);
         scenePtr->removeItem(trace.second_);
+        scenePtr->removeItem(trace.points_);
         delete trace.first_;
         delete trace.second_;
+        delete trace.points_;
     }
     traces_.clear();
-    overlay_.clear();
+    resetOverlay();
     // redraw
     scene()->invalidate();
 }
@@ -272,13 +623,10 @@ void UltrasoundImage::resizeEvent(QResizeEvent* e)
 {
     auto w = e->size().width(), h = e->size().height();
 
+    // the current image is scaled to the new size until frames at the negotiated size arrive
     setSceneRect(0, 0, w, h);
-    castSetOutputSize(w, h);
-
-    image_ = QImage(w, h, QImage::Format_ARGB32);
-    image_.fill(Qt::black);
-
-    overlay_.clear();
+    resetOverlay();
+    emit resized(QSize(w, h));
 
     QGraphicsView::resizeEvent(e);
 }
@@ -289,11 +637,8 @@ void UltrasoundImage::mouseMoveEvent(QMouseEvent* event)
 
     if (event->buttons() == Qt::RightButton)
     {
-        overlay_.moveTo(lastPoint_);
-        overlay_.lineTo(event->pos());
+        addStroke(lastPoint_, event->pos());
         lastPoint_ = event->pos();
-        // redraw
-        scene()->invalidate();
     }
 }
 
@@ -309,14 +654,8 @@ void UltrasoundImage::mouseReleaseEvent(QMouseEvent* event)
     QGraphicsView::mouseReleaseEvent(event);
 
     if (event->buttons() == Qt::RightButton)
-    {
-        overlay_.moveTo(lastPoint_);
-        overlay_.lineTo(event->pos());
-    }
+        addStroke(lastPoint_, event->pos());
     lastPoint_ = event->pos();
-
-    // redraw
-    scene()->invalidate();
 }
 
 /// calculates the ratio of the test image to determine the proper height ratio for width
@@ -346,19 +685,25 @@ void UltrasoundImage::drawBackground(QPainter* painter, const QRectF& r)
 
     painter->fillRect(r, QBrush(Qt::black));
 
+    // only the exposed part is drawn, it is only rescaled while the received size differs from the view
     if (!image_.isNull())
-        painter->drawImage(r, image_);
+    {
+#ifdef CASTER_OPENGL
+        drawTexture(painter);
+#else
+        painter->drawImage(r, image_, toImage().mapRect(r));
+#endif
+    }
+    if (!layer_.isNull())
+        painter->drawImage(r, layer_, toImage().mapRect(r));
 
-    QColor overlayColor(overlayColor_);
-    overlayColor.setAlpha(255);
-    QPen pen(overlayColor);
-    pen.setWidth(20);
-    pen.setCapStyle(Qt::RoundCap);
-    pen.setJoinStyle(Qt::RoundJoin);
-    painter->setOpacity(overlayColor_.alphaF());
-    painter->setPen(pen);
-    painter->drawPath(overlay_);
-    painter->setOpacity(1.0);
+    // the user overlay is rasterized into its own layer as it is drawn
+    if (hasOverlay_)
+    {
+        painter->setOpacity(overlayColor_.alphaF());
+        painter->drawImage(r, overlayLayer_, r);
+        painter->setOpacity(1.0);
+    }
 
     if (noImage_)
     {
@@ -368,6 +713,43 @@ void UltrasoundImage::drawBackground(QPainter* painter, const QRectF& r)
     }
 }
 
+#ifdef CASTER_OPENGL
+/// draws the image through a persistent texture, only uploading the pixels when a new frame arrived
+/// @param[in] painter the drawing context, must be painting on the gl viewport
+void UltrasoundImage::drawTexture(QPainter* painter)
+{
+    painter->beginNativePainting();
+
+    if (!blitter_.isCreated())
+        blitter_.create();
+
+    if (!texture_ || texture_->width() != image_.width() || texture_->height() != image_.height())
+    {
+        texture_ = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+        texture_->setFormat(QOpenGLTexture::RGBA8_UNorm);
+        texture_->setSize(image_.width(), image_.height());
+        texture_->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        texture_->setWrapMode(QOpenGLTexture::ClampToEdge);
+        texture_->allocateStorage(QOpenGLTexture::BGRA, QOpenGLTexture::UInt8);
+        imageDirty_ = true;
+    }
+
+    // argb32 is stored as bgra in memory, so it can be uploaded as is
+    if (imageDirty_)
+    {
+        texture_->setData(QOpenGLTexture::BGRA, QOpenGLTexture::UInt8, image_.constBits());
+        imageDirty_ = false;
+    }
+
+    const QRect vp(QPoint(0, 0), viewport()->size());
+    blitter_.bind();
+    blitter_.blit(texture_->textureId(), QOpenGLTextureBlitter::targetTransform(QRectF(vp), vp), QOpenGLTextureBlitter::OriginTopLeft);
+    blitter_.release();
+
+    painter->endNativePainting();
+}
+#endif
+
 /// draws the target image
 /// @param[in] painter the drawing context
 void UltrasoundImage::drawForeground(QPainter* painter, const QRectF& r)
@@ -377,7 +759,7 @@ void UltrasoundImage::drawForeground(QPainter* painter, const QRectF& r)
 
 /// default constructor
 /// @param[in] parent the parent object
-RfSignal::RfSignal(QWidget* parent) : QGraphicsView(parent), zoom_(0.1)
+RfSignal::RfSignal(QWidget* parent) : QGraphicsView(parent), waterfallPos_(0), waterfallMode_(false), zoom_(0.1)
 {
     QGraphicsScene* sc = new QGraphicsScene(this);
     setScene(sc);
@@ -404,10 +786,13 @@ void RfSignal::loadSignal(const void* rf, int l, int s, int ss)
         setVisible(true);
 
     // pick the center line to display
-    signal_.clear();
     const int16_t* buf = static_cast<const int16_t*>(rf) + ((l / 2) * s);
-    for (auto i = 0; i < s; i++)
-        signal_.push_back(*buf++);
+    signal_.resize(s);
+    std::memcpy(signal_.data(), buf, s * sizeof(int16_t));
+
+    // the waterfall keeps collecting history even when the single line is displayed
+    addWaterfallLine(buf, s);
+    decimate();
 
     // redraw
     scene()->invalidate();
@@ -418,6 +803,81 @@ void RfSignal::loadSignal(const void* rf, int l, int s, int ss)
 void RfSignal::setZoom(int zoom)
 {
     zoom_ = (static_cast<qreal>(zoom) / 100.0);
+    decimate();
+}
+
+/// switches between the single line display and the waterfall (m-mode) display
+/// @param[in] en flag to display the waterfall
+void RfSignal::setWaterfall(bool en)
+{
+    waterfallMode_ = en;
+    scene()->invalidate();
+}
+
+/// reduces the signal to at most two points per pixel column
+/// @details each column holds the minimum and maximum of the samples that fall into it, so the polyline keeps the
+///          full envelope of the signal while the # of points only depends on the width of the view
+void RfSignal::decimate()
+{
+    trace_.clear();
+    const int s = signal_.size();
+    const int w = static_cast<int>(sceneRect().width());
+    if (!s || w <= 0)
+        return;
+
+    const qreal baseline = sceneRect().height() / 2;
+    const int16_t* buf = signal_.constData();
+    if (s <= w * 2)
+    {
+        // fewer samples than pixels, plot every sample
+        const qreal sampleSize = static_cast<qreal>(w) / static_cast<qreal>(s);
+        trace_.reserve(s);
+        for (auto i = 0; i < s; i++)
+            trace_.push_back(QPointF(i * sampleSize, baseline + buf[i] * zoom_));
+        return;
+    }
+
+    trace_.reserve(w * 2);
+    int16_t lo, hi;
+    for (auto x = 0; x < w; x++)
+    {
+        const int a = static_cast<int>(static_cast<long long>(x) * s / w);
+        const int b = static_cast<int>(static_cast<long long>(x + 1) * s / w);
+        minMax(buf + a, std::max(b - a, 1), lo, hi);
+        trace_.push_back(QPointF(x, baseline + lo * zoom_));
+        trace_.push_back(QPointF(x, baseline + hi * zoom_));
+    }
+}
+
+/// adds the envelope of a line to the waterfall ring
+/// @details only the newest column is written, the history is never redrawn, the ring is unrolled when painting
+/// @param[in] line the rf samples
+/// @param[in] s # of samples
+void RfSignal::addWaterfallLine(const int16_t* line, int s)
+{
+    const int rows = std::min(s, kWaterfallRows);
+    if (waterfall_.height() != rows)
+    {
+        waterfall_ = QImage(kWaterfallLines, rows, QImage::Format_Grayscale8);
+        waterfall_.fill(0);
+        waterfallPos_ = 0;
+    }
+
+    // log compress the peak amplitude of each depth bin
+    static const double norm = 255.0 / std::log(32769.0);
+    uchar* bits = waterfall_.bits() + waterfallPos_;
+    const qsizetype stride = waterfall_.bytesPerLine();
+    int16_t lo, hi;
+    for (auto y = 0; y < rows; y++)
+    {
+        const int a = static_cast<int>(static_cast<long long>(y) * s / rows);
+        const int b = static_cast<int>(static_cast<long long>(y + 1) * s / rows);
+        minMax(line + a, std::max(b - a, 1), lo, hi);
+        const int peak = std::max(std::abs(static_cast<int>(lo)), std::abs(static_cast<int>(hi)));
+        bits[y * stride] = static_cast<uchar>(std::min(std::log(1.0 + peak) * norm, 255.0));
+    }
+
+    waterfallPos_ = (waterfallPos_ + 1) % kWaterfallLines;
 }
 
 /// handles resizing of the image view
@@ -426,6 +886,7 @@ void RfSignal::resizeEvent(QResizeEvent* e)
 {
     auto w = e->size().width(), h = e->size().height();
     setSceneRect(0, 0, w, h);
+    decimate();
     QGraphicsView::resizeEvent(e);
 }
 
@@ -461,19 +922,24 @@ void RfSignal::drawBackground(QPainter* painter, const QRectF& r)
 /// @param[in] r the view rectangle
 void RfSignal::drawForeground(QPainter* painter, const QRectF& r)
 {
-    if (!signal_.isEmpty())
+    Q_UNUSED(r)
+    if (waterfallMode_)
+    {
+        if (waterfall_.isNull())
+            return;
+
+        // unroll the ring so the oldest line is on the left and the newest on the right
+        const QRectF v = sceneRect();
+        const qreal lineWidth = v.width() / kWaterfallLines;
+        const int older = kWaterfallLines - waterfallPos_;
+        const int h = waterfall_.height();
+        painter->drawImage(QRectF(v.left(), v.top(), older * lineWidth, v.height()), waterfall_, QRectF(waterfallPos_, 0, older, h));
+        if (waterfallPos_)
+            painter->drawImage(QRectF(v.left() + older * lineWidth, v.top(), waterfallPos_ * lineWidth, v.height()), waterfall_, QRectF(0, 0, waterfallPos_, h));
+    }
+    else if (!trace_.isEmpty())
     {
         painter->setPen(QColor(96, 96, 0));
-        qreal x = 0, baseline = r.height() / 2;
-        double sampleSize = static_cast<double>(r.width()) / static_cast<double>(signal_.size());
-        QPointF p(x, baseline);
-        for (auto s : signal_)
-        {
-            qreal y = s * zoom_;
-            QPointF pt(x + sampleSize, baseline + y);
-            painter->drawLine(p, pt);
-            p = pt;
-            x = x + sampleSize;
-        }
+        painter->drawPolyline(trace_.constData(), static_cast<int>(trace_.size()));
     }
 }
@@ -2,6 +2,7 @@
 
 #define NO_IMAGE_STATEMENT QStringLiteral("No Image? Check the O/S Firewall Settings")
 
+#include "lut.h"
 #include <deque>
 
 struct LabelInfo
@@ -15,14 +16,43 @@ struct LabelInfo
 
 struct TraceInfo
 {
-    explicit TraceInfo(const QString& text, const QPolygonF& points)
-        : text_(text), points_(points)
+    explicit TraceInfo(const QString& text, const QPolygonF& points, double length, double area)
+        : text_(text), points_(points), length_(length), area_(area)
     {}
     QString text_;
     QPolygonF points_;
+    double length_;     ///< length of the trace in pixels
+    double area_;       ///< area enclosed by the trace when closed, in square pixels
 };
 
-using PointList = std::deque<QGraphicsItem*>;
+/// points of a trace between its two calipers, drawn as a single item
+/// @details points are added at either end as the calipers move, a point that continues the last segment in a straight
+///          line replaces the previous end point instead of being added, and moving back over the last segment
+///          shortens or removes it. the length and the shoelace sum for the area are kept up to date at each change
+class TraceItem : public QGraphicsItem
+{
+public:
+    TraceItem();
+
+    void moveEnd(const QPointF& pt, bool front);
+    const std::deque<QPointF>& points() const { return points_; }
+    double length() const { return length_; }
+    double cross() const { return cross_; }
+
+    virtual QRectF boundingRect() const override;
+    virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    void push(const QPointF& pt, bool front);
+    void pop(bool front);
+
+private:
+    std::deque<QPointF> points_;    ///< trace points, ordered from the first to the second caliper
+    double length_;                 ///< sum of the segment lengths
+    double cross_;                  ///< sum of the segment cross products
+    mutable QRectF bounds_;         ///< cached bounding box
+    mutable bool boundsDirty_;      ///< flag that the bounding box has to be recalculated
+};
 
 /// ultrasound image display
 class UltrasoundImage : public QGraphicsView
@@ -30,17 +60,30 @@ class UltrasoundImage : public QGraphicsView
     Q_OBJECT
 public:
     explicit UltrasoundImage(QWidget*);
+    ~UltrasoundImage() override;
 
     void loadImage(const void* img, int w, int h, int bpp, int sz);
+    void setImageSize(int w, int h);
+    DisplayLut& lut() { return lut_; }
+    void applyLut();
+    void loadOverlay(const void* img, int w, int h);
+    void refresh();
     void setNoImage(bool en) { noImage_ = en; }
+    const QImage& image() const { return image_; }
+    QImage& image() { return image_; }
     void addLabel(const QString& text);
     void addTrace(const QString& text);
     void clearOverlays();
-    QImage overlayImage() const;
+    const QImage& overlayImage() const { return mask_; }
+    bool hasOverlay() const { return hasOverlay_; }
+    QTransform toImage() const;
     QColor overlayColor() const { return overlayColor_; }
     std::vector<LabelInfo> getLabels() const;
     std::vector<TraceInfo> getTraces() const;
 
+signals:
+    void resized(const QSize& sz);
+
 protected:
     virtual void drawForeground(QPainter*, const QRectF&) override;
     virtual void drawBackground(QPainter*, const QRectF&) override;
@@ -52,17 +95,34 @@ protected:
     virtual QSize sizeHint() const override;
 
 private:
+#ifdef CASTER_OPENGL
+    void drawTexture(QPainter* painter);
+#endif
+    void resetOverlay();
+    void addStroke(const QPoint& from, const QPoint& to);
+
     struct Trace
     {
         QGraphicsRectItem* first_;
         QGraphicsRectItem* second_;
         QString text_;
-        std::shared_ptr<PointList> points_;
+        TraceItem* points_;
     };
 
     bool noImage_;  ///< no image flag for potential firewall issues
     QImage image_;  ///< the image buffer
-    QPainterPath overlay_; ///< user overlay
+    QImage layer_;  ///< separated color overlay, drawn over the image
+    bool imageDirty_;   ///< flag that the image changed since it was last uploaded
+    DisplayLut lut_;    ///< display mapping of 8 bit frames
+    std::vector<uchar> gray_;   ///< latest 8 bit frame, kept to reapply the mapping when it changes
+    std::vector<uchar> maskData_;   ///< contiguous storage of the user overlay mask, in view coordinates
+    QImage mask_;           ///< user overlay mask wrapping the contiguous storage, exported at capture time
+    QImage overlayLayer_;   ///< colored rendering of the user overlay
+    bool hasOverlay_;       ///< flag that the user has drawn an overlay
+#ifdef CASTER_OPENGL
+    std::unique_ptr<QOpenGLTexture> texture_;   ///< persistent texture holding the latest image
+    QOpenGLTextureBlitter blitter_;             ///< draws the texture into the viewport
+#endif
     QColor overlayColor_; ///< overlay color
     QPoint lastPoint_;
     std::vector<QGraphicsItem*> labels_;
@@ -78,6 +138,7 @@ public:
 
     void loadSignal(const void* rf, int l, int s, int ss);
     void setZoom(int zoom);
+    void setWaterfall(bool en);
 
 protected:
     virtual void drawForeground(QPainter*, const QRectF&) override;
@@ -87,7 +148,15 @@ protected:
     virtual int heightForWidth(int w) const override;
     virtual QSize sizeHint() const override;
 
+private:
+    void decimate();
+    void addWaterfallLine(const int16_t* line, int s);
+
 private:
     QVector<int16_t> signal_;   ///< the rf signal
+    QVector<QPointF> trace_;    ///< min/max decimated signal at pixel resolution
+    QImage waterfall_;          ///< ring of envelope lines, one column per frame
+    int waterfallPos_;          ///< next column to write in the ring
+    bool waterfallMode_;        ///< flag to display the waterfall instead of the signal
     qreal zoom_;                ///< zoom level
 };
@@ -0,0 +1,206 @@
+#include "format.h"
+#include <cast/cast.h>
+#include <cmath>
+
+namespace
+{
+    /// formats ordered from the most to the least bandwidth
+    const CusImageFormat kFormats[] = { Uncompressed, Uncompressed8Bit, Png, Jpeg };
+    const int kLevels = 4;
+    /// typical bytes per pixel of each format, until measured
+    const double kBytesPerPixel[] = { 4.0, 1.0, 0.5, 0.1 };
+    /// length of an evaluation window in seconds
+    const double kWindow = 2.0;
+    /// fraction of the target frame rate below which a window fails
+    const double kLowRate = 0.85;
+    /// fraction of the target frame rate a window needs to count as good
+    const double kHighRate = 0.95;
+    /// jitter, relative to the mean frame interval, above which a window fails
+    const double kMaxJitter = 0.5;
+    /// # of consecutive good windows before stepping up
+    const int kStepUpWindows = 3;
+    /// fraction of the peak throughput a heavier format may use
+    const double kHeadroom = 0.7;
+
+    /// finds the level of a format
+    /// @param[in] format the format
+    /// @return the level, 0 if unknown
+    int levelOf(CusImageFormat format)
+    {
+        for (auto i = 0; i < kLevels; i++)
+        {
+            if (kFormats[i] == format)
+                return i;
+        }
+        return 0;
+    }
+}
+
+/// default constructor
+/// @param[in] parent the parent object
+FormatSelector::FormatSelector(QObject* parent) : QObject(parent), enabled_(false), level_(0)
+{
+    reset(Uncompressed);
+}
+
+/// enables or disables automatic selection
+/// @param[in] en the enable state
+void FormatSelector::setEnabled(bool en)
+{
+    CusImageFormat format;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        enabled_ = en;
+        format = kFormats[level_];
+    }
+    reset(format);
+}
+
+/// restarts the measurements
+/// @param[in] format the format currently streamed
+void FormatSelector::reset(CusImageFormat format)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    level_ = levelOf(format);
+    pending_ = false;
+    goodWindows_ = 0;
+    windowStart_ = lastTime_ = 0;
+    frames_ = 0;
+    bytes_ = pixels_ = intervalSum_ = intervalSquares_ = 0;
+    targetFps_ = peakThroughput_ = 0;
+    for (auto i = 0; i < kLevels; i++)
+        bytesPerPixel_[i] = 0;
+}
+
+/// retrieves the requested format
+/// @return the format
+CusImageFormat FormatSelector::format() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return kFormats[level_];
+}
+
+/// updates the measurements with a received frame
+/// @param[in] tm the frame timestamp in nanoseconds
+/// @param[in] bytes the size of the frame as transmitted
+/// @param[in] pixels the # of pixels in the frame
+/// @param[in] format the format the frame was sent in
+/// @param[in] fps the acquisition frame rate
+/// @details called from the api thread as frames arrive, so frames the gui was too busy to display still count
+void FormatSelector::addFrame(long long int tm, int bytes, int pixels, CusImageFormat format, double fps)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!enabled_ || pixels <= 0)
+        return;
+
+    // frames still in the previous format say nothing about the new one
+    const int level = levelOf(format);
+    if (pending_)
+    {
+        if (level != level_)
+            return;
+        pending_ = false;
+        windowStart_ = lastTime_ = 0;
+    }
+
+    const double bpp = static_cast<double>(bytes) / pixels;
+    bytesPerPixel_[level] = bytesPerPixel_[level] > 0 ? bytesPerPixel_[level] * 0.9 + bpp * 0.1 : bpp;
+    if (fps > 0)
+        targetFps_ = fps;
+
+    if (!windowStart_)
+    {
+        windowStart_ = lastTime_ = tm;
+        frames_ = 0;
+        bytes_ = pixels_ = intervalSum_ = intervalSquares_ = 0;
+        return;
+    }
+    if (tm <= lastTime_)
+        return;
+
+    const double interval = static_cast<double>(tm - lastTime_) / 1e9;
+    lastTime_ = tm;
+    frames_++;
+    bytes_ += bytes;
+    pixels_ += pixels;
+    intervalSum_ += interval;
+    intervalSquares_ += interval * interval;
+
+    if (static_cast<double>(tm - windowStart_) / 1e9 >= kWindow)
+    {
+        evaluate();
+        windowStart_ = tm;
+        frames_ = 0;
+        bytes_ = pixels_ = intervalSum_ = intervalSquares_ = 0;
+    }
+}
+
+/// evaluates a completed window and switches formats if needed, called with the lock held
+void FormatSelector::evaluate()
+{
+    if (frames_ < 2 || intervalSum_ <= 0 || targetFps_ <= 0)
+        return;
+
+    const double fps = frames_ / intervalSum_;
+    const double mean = intervalSum_ / frames_;
+    const double jitter = std::sqrt(std::max(intervalSquares_ / frames_ - mean * mean, 0.0)) / mean;
+    const double throughput = bytes_ / intervalSum_;
+    peakThroughput_ = std::max(peakThroughput_, throughput);
+
+    if (fps < targetFps_ * kLowRate || jitter > kMaxJitter)
+    {
+        goodWindows_ = 0;
+        if (level_ + 1 < kLevels)
+            request(level_ + 1, QStringLiteral("%1 fps of %2, jitter %3%").arg(fps, 0, 'f', 1).arg(targetFps_, 0, 'f', 1).arg(jitter * 100.0, 0, 'f', 0));
+        return;
+    }
+
+    if (fps < targetFps_ * kHighRate || level_ == 0)
+    {
+        goodWindows_ = 0;
+        return;
+    }
+
+    if (++goodWindows_ < kStepUpWindows)
+        return;
+
+    // only step up if the heavier format is expected to fit in the link with some headroom, a format that was never
+    // measured is probed since the peak throughput of a lighter format says little about the link capacity
+    const int up = level_ - 1;
+    const double bpp = bytesPerPixel_[up] > 0 ? bytesPerPixel_[up] : kBytesPerPixel[up];
+    const double needed = bpp * (pixels_ / frames_) * targetFps_;
+    if (bytesPerPixel_[up] <= 0 || needed < peakThroughput_ * kHeadroom)
+        request(up, QStringLiteral("%1 fps sustained, %2 of %3 KB/s needed").arg(fps, 0, 'f', 1).arg(needed / 1024.0, 0, 'f', 0).arg(peakThroughput_ / 1024.0, 0, 'f', 0));
+    goodWindows_ = 0;
+}
+
+/// switches to a new format, the scanner is asked from the gui thread, called with the lock held
+/// @param[in] level the new format level
+/// @param[in] reason description of why the format changed
+void FormatSelector::request(int level, const QString& reason)
+{
+    const int from = level_;
+    level_ = level;
+    pending_ = true;
+    goodWindows_ = 0;
+    QMetaObject::invokeMethod(this, [this, from, level, reason]() { apply(from, level, reason); }, Qt::QueuedConnection);
+}
+
+/// requests a new format from the scanner
+/// @param[in] from the previous format level, restored if the request fails
+/// @param[in] level the new format level
+/// @param[in] reason description of why the format changed
+void FormatSelector::apply(int from, int level, const QString& reason)
+{
+    if (castSetFormat(kFormats[level]) < 0)
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (level_ == level)
+        {
+            level_ = from;
+            pending_ = false;
+        }
+        return;
+    }
+    emit formatChanged(kFormats[level], reason);
+}
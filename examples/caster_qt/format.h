@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cast/cast_def.h>
+#include <mutex>
+
+/// selects the stream format that holds the acquisition frame rate over the current link
+/// @details formats are ordered from the most to the least bandwidth: uncompressed argb, uncompressed 8 bit, png and
+///          jpeg. the delivered frame rate, the inter-frame jitter and the receive throughput are measured over
+///          evaluation windows. a window that falls short of the target steps down to a lighter format right away,
+///          stepping back up needs several good windows in a row and a throughput estimate that fits the heavier
+///          format, so the selection does not oscillate. measurements are ignored until frames in a newly requested
+///          format arrive. frames are measured from the api thread as they arrive, so a busy gui does not read as a
+///          bad link, the scanner is asked for a new format from the gui thread
+class FormatSelector : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FormatSelector(QObject* parent = nullptr);
+
+    void setEnabled(bool en);
+    bool enabled() const { return enabled_; }
+    void reset(CusImageFormat format);
+    void addFrame(long long int tm, int bytes, int pixels, CusImageFormat format, double fps);
+    CusImageFormat format() const;
+
+signals:
+    void formatChanged(CusImageFormat format, const QString& reason);
+
+private:
+    void evaluate();
+    void request(int level, const QString& reason);
+    void apply(int from, int level, const QString& reason);
+
+private:
+    mutable std::mutex lock_;   ///< guards the selection and the measurements, frames are added from the api thread
+    bool enabled_;              ///< flag that formats are selected automatically
+    int level_;                 ///< requested format, as an index into the ordered formats
+    bool pending_;              ///< flag that frames in the requested format have not arrived yet
+    int goodWindows_;           ///< # of consecutive windows that met the target
+    long long int windowStart_; ///< timestamp of the first frame in the window
+    long long int lastTime_;    ///< timestamp of the latest frame
+    int frames_;                ///< # of frames in the window
+    double bytes_;              ///< bytes received in the window
+    double pixels_;             ///< pixels received in the window
+    double intervalSum_;        ///< sum of the inter-frame intervals in the window, in seconds
+    double intervalSquares_;    ///< sum of the squared inter-frame intervals in the window
+    double targetFps_;          ///< acquisition frame rate reported by the scanner
+    double peakThroughput_;     ///< highest throughput seen in a window, in bytes per second
+    double bytesPerPixel_[4];   ///< measured bytes per pixel of each format, 0 until seen
+};
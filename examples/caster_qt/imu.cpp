@@ -0,0 +1,352 @@
+#include "imu.h"
+#include <algorithm>
+#include <cmath>
+
+/// default constructor
+/// @param[in] capacity the maximum # of samples kept in the history
+ImuBuffer::ImuBuffer(int capacity) : samples_(std::max(capacity, 2)), head_(0), count_(0), fusion_(false), beta_(0.1), q_{ 1, 0, 0, 0 }
+{
+}
+
+/// enables local sensor fusion
+/// @param[in] en the enable flag, when disabled the probe's orientation is used as is
+/// @param[in] beta the filter gain, higher values trust the accelerometer and magnetometer more than the gyroscope
+void ImuBuffer::setFusion(bool en, double beta)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    fusion_ = en;
+    beta_ = beta;
+}
+
+/// discards the history
+void ImuBuffer::clear()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    head_ = count_ = 0;
+    q_[0] = 1;
+    q_[1] = q_[2] = q_[3] = 0;
+}
+
+/// adds a single sample
+/// @param[in] pos the positional data
+void ImuBuffer::add(const CusPosInfo& pos)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    addSample(pos);
+}
+
+/// adds a block of samples, typically the positional data tagged with a frame
+/// @param[in] pos the positional data
+/// @param[in] n # of samples
+void ImuBuffer::add(const CusPosInfo* pos, int n)
+{
+    if (!pos || n <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto i = 0; i < n; i++)
+        addSample(pos[i]);
+}
+
+/// checks if the history is empty
+/// @return true if there are no samples
+bool ImuBuffer::empty() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return count_ == 0;
+}
+
+/// retrieves the timestamp of the latest sample
+/// @return the timestamp in nanoseconds, 0 if there are no samples
+long long int ImuBuffer::latest() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return count_ ? at(count_ - 1).tm_ : 0;
+}
+
+/// appends a sample to the ring, must be called with the lock held
+/// @param[in] pos the positional data
+void ImuBuffer::addSample(const CusPosInfo& pos)
+{
+    const long long int last = count_ ? at(count_ - 1).tm_ : 0;
+    if (count_ && pos.tm <= last)
+        return;
+
+    if (fusion_ && count_)
+        fuse(pos, std::min(static_cast<double>(pos.tm - last) * 1e-9, 0.1));
+    else
+    {
+        q_[0] = pos.qw;
+        q_[1] = pos.qx;
+        q_[2] = pos.qy;
+        q_[3] = pos.qz;
+    }
+
+    Sample s{ pos.tm, QQuaternion(static_cast<float>(q_[0]), static_cast<float>(q_[1]), static_cast<float>(q_[2]), static_cast<float>(q_[3])) };
+    const int cap = static_cast<int>(samples_.size());
+    if (count_ < cap)
+        samples_[(head_ + count_++) % cap] = s;
+    else
+    {
+        samples_[head_] = s;
+        head_ = (head_ + 1) % cap;
+    }
+}
+
+/// runs one step of the madgwick marg filter
+/// @param[in] pos the raw sensor data
+/// @param[in] dt time since the previous sample in seconds
+void ImuBuffer::fuse(const CusPosInfo& pos, double dt)
+{
+    double q0 = q_[0], q1 = q_[1], q2 = q_[2], q3 = q_[3];
+    double gx = pos.gx, gy = pos.gy, gz = pos.gz;
+    double ax = pos.ax, ay = pos.ay, az = pos.az;
+    double mx = pos.mx, my = pos.my, mz = pos.mz;
+
+    // rate of change of the quaternion from the gyroscope
+    double qd0 = 0.5 * (-q1 * gx - q2 * gy - q3 * gz);
+    double qd1 = 0.5 * (q0 * gx + q2 * gz - q3 * gy);
+    double qd2 = 0.5 * (q0 * gy - q1 * gz + q3 * gx);
+    double qd3 = 0.5 * (q0 * gz + q1 * gy - q2 * gx);
+
+    const double an = std::sqrt(ax * ax + ay * ay + az * az);
+    const double mn = std::sqrt(mx * mx + my * my + mz * mz);
+    if (an > 0 && mn > 0)
+    {
+        ax /= an; ay /= an; az /= an;
+        mx /= mn; my /= mn; mz /= mn;
+
+        // reference direction of the earth's magnetic field
+        const double hx = 2 * (mx * (0.5 - q2 * q2 - q3 * q3) + my * (q1 * q2 - q0 * q3) + mz * (q1 * q3 + q0 * q2));
+        const double hy = 2 * (mx * (q1 * q2 + q0 * q3) + my * (0.5 - q1 * q1 - q3 * q3) + mz * (q2 * q3 - q0 * q1));
+        const double bx = std::sqrt(hx * hx + hy * hy);
+        const double bz = 2 * (mx * (q1 * q3 - q0 * q2) + my * (q2 * q3 + q0 * q1) + mz * (0.5 - q1 * q1 - q2 * q2));
+
+        // objective function and jacobian for the gradient descent step
+        const double f0 = 2 * (q1 * q3 - q0 * q2) - ax;
+        const double f1 = 2 * (q0 * q1 + q2 * q3) - ay;
+        const double f2 = 2 * (0.5 - q1 * q1 - q2 * q2) - az;
+        const double f3 = 2 * bx * (0.5 - q2 * q2 - q3 * q3) + 2 * bz * (q1 * q3 - q0 * q2) - mx;
+        const double f4 = 2 * bx * (q1 * q2 - q0 * q3) + 2 * bz * (q0 * q1 + q2 * q3) - my;
+        const double f5 = 2 * bx * (q0 * q2 + q1 * q3) + 2 * bz * (0.5 - q1 * q1 - q2 * q2) - mz;
+
+        double s0 = -2 * q2 * f0 + 2 * q1 * f1 - 2 * bz * q2 * f3 + (-2 * bx * q3 + 2 * bz * q1) * f4 + 2 * bx * q2 * f5;
+        double s1 = 2 * q3 * f0 + 2 * q0 * f1 - 4 * q1 * f2 + 2 * bz * q3 * f3 + (2 * bx * q2 + 2 * bz * q0) * f4 + (2 * bx * q3 - 4 * bz * q1) * f5;
+        double s2 = -2 * q0 * f0 + 2 * q3 * f1 - 4 * q2 * f2 + (-4 * bx * q2 - 2 * bz * q0) * f3 + (2 * bx * q1 + 2 * bz * q3) * f4 + (2 * bx * q0 - 4 * bz * q2) * f5;
+        double s3 = 2 * q1 * f0 + 2 * q2 * f1 + (-4 * bx * q3 + 2 * bz * q1) * f3 + (-2 * bx * q0 + 2 * bz * q2) * f4 + 2 * bx * q1 * f5;
+        const double sn = std::sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+        if (sn > 0)
+        {
+            qd0 -= beta_ * s0 / sn;
+            qd1 -= beta_ * s1 / sn;
+            qd2 -= beta_ * s2 / sn;
+            qd3 -= beta_ * s3 / sn;
+        }
+    }
+
+    q0 += qd0 * dt;
+    q1 += qd1 * dt;
+    q2 += qd2 * dt;
+    q3 += qd3 * dt;
+    const double qn = std::sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    if (qn > 0)
+    {
+        q_[0] = q0 / qn;
+        q_[1] = q1 / qn;
+        q_[2] = q2 / qn;
+        q_[3] = q3 / qn;
+    }
+}
+
+/// finds the first sample at or after a timestamp
+/// @param[in] tm the timestamp
+/// @param[in] first the first index to consider
+/// @return the sample index, count_ if every sample is older
+int ImuBuffer::lowerBound(long long int tm, int first) const
+{
+    int lo = first, hi = count_;
+    while (lo < hi)
+    {
+        const int mid = lo + (hi - lo) / 2;
+        if (at(mid).tm_ < tm)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/// interpolates the orientation at a timestamp
+/// @param[in] i index of the first sample at or after the timestamp
+/// @param[in] tm the timestamp
+/// @return the orientation, clamped to the ends of the history
+QQuaternion ImuBuffer::interpolate(int i, long long int tm) const
+{
+    if (i <= 0)
+        return at(0).q_;
+    if (i >= count_)
+        return at(count_ - 1).q_;
+
+    const Sample& a = at(i - 1);
+    const Sample& b = at(i);
+    const float t = static_cast<float>(static_cast<double>(tm - a.tm_) / static_cast<double>(b.tm_ - a.tm_));
+    return QQuaternion::slerp(a.q_, b.q_, t);
+}
+
+/// retrieves the orientation at a timestamp
+/// @param[in] tm the timestamp in nanoseconds, typically the timestamp of a frame
+/// @return the orientation, a null quaternion if there is no history
+QQuaternion ImuBuffer::orientation(long long int tm) const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!count_)
+        return QQuaternion(0, 0, 0, 0);
+
+    return interpolate(lowerBound(tm, 0), tm);
+}
+
+/// retrieves the orientations at a batch of timestamps
+/// @param[in] tm the timestamps in nanoseconds
+/// @param[in] n # of timestamps
+/// @param[out] out the orientations, must hold n entries
+/// @note ascending timestamps are resolved with a single forward sweep of the history
+void ImuBuffer::orientations(const long long int* tm, int n, QQuaternion* out) const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    int hint = 0;
+    for (auto i = 0; i < n; i++)
+    {
+        if (!count_)
+        {
+            out[i] = QQuaternion(0, 0, 0, 0);
+            continue;
+        }
+
+        // sweep forward from the previous result when possible, fall back to a full search otherwise
+        int idx = (i && tm[i] >= tm[i - 1]) ? hint : 0;
+        for (auto steps = 0; idx < count_ && at(idx).tm_ < tm[i] && steps < 8; steps++)
+            idx++;
+        if (idx < count_ && at(idx).tm_ < tm[i])
+            idx = lowerBound(tm[i], idx);
+        hint = idx;
+        out[i] = interpolate(idx, tm[i]);
+    }
+}
+
+/// discards the samples, keeping the allocations
+void ImuBatch::clear()
+{
+    for (auto v : { &gx_, &gy_, &gz_, &ax_, &ay_, &az_, &mx_, &my_, &mz_, &qw_, &qx_, &qy_, &qz_ })
+        v->clear();
+    tm_.clear();
+}
+
+/// appends a sample
+/// @param[in] pos the positional data
+void ImuBatch::append(const CusPosInfo& pos)
+{
+    tm_.push_back(pos.tm);
+    gx_.push_back(pos.gx);
+    gy_.push_back(pos.gy);
+    gz_.push_back(pos.gz);
+    ax_.push_back(pos.ax);
+    ay_.push_back(pos.ay);
+    az_.push_back(pos.az);
+    mx_.push_back(pos.mx);
+    my_.push_back(pos.my);
+    mz_.push_back(pos.mz);
+    qw_.push_back(pos.qw);
+    qx_.push_back(pos.qx);
+    qy_.push_back(pos.qy);
+    qz_.push_back(pos.qz);
+}
+
+/// appends the samples of another batch
+/// @param[in] batch the samples to append
+void ImuBatch::append(const ImuBatch& batch)
+{
+    auto join = [](auto& dst, const auto& src) { dst.insert(dst.end(), src.begin(), src.end()); };
+    join(tm_, batch.tm_);
+    join(gx_, batch.gx_);
+    join(gy_, batch.gy_);
+    join(gz_, batch.gz_);
+    join(ax_, batch.ax_);
+    join(ay_, batch.ay_);
+    join(az_, batch.az_);
+    join(mx_, batch.mx_);
+    join(my_, batch.my_);
+    join(mz_, batch.mz_);
+    join(qw_, batch.qw_);
+    join(qx_, batch.qx_);
+    join(qy_, batch.qy_);
+    join(qz_, batch.qz_);
+}
+
+/// calculates the mean angular velocity over the batch
+/// @return the angular velocity in radians per second, zero if the batch is empty
+QVector3D ImuBatch::meanGyro() const
+{
+    if (tm_.empty())
+        return QVector3D();
+
+    // independent sums over contiguous arrays, which the compiler vectorizes
+    const size_t n = tm_.size();
+    double x = 0, y = 0, z = 0;
+    for (size_t i = 0; i < n; i++)
+        x += gx_[i];
+    for (size_t i = 0; i < n; i++)
+        y += gy_[i];
+    for (size_t i = 0; i < n; i++)
+        z += gz_[i];
+    return QVector3D(static_cast<float>(x / n), static_cast<float>(y / n), static_cast<float>(z / n));
+}
+
+/// default constructor
+/// @param[in] type the event type posted when a batch is ready
+ImuBatcher::ImuBatcher(QEvent::Type type) : type_(type), period_(0), pending_(false)
+{
+}
+
+/// sets the batch period
+/// @param[in] ms the period in milliseconds, 0 to deliver every sample
+void ImuBatcher::setPeriod(int ms)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    period_ = static_cast<long long int>(std::max(ms, 0)) * 1000000LL;
+}
+
+/// adds a streamed sample, posting an event when the batch is complete
+/// @param[in] pos the positional data
+/// @param[in] receiver the object receiving the event
+void ImuBatcher::add(const CusPosInfo& pos, QObject* receiver)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    collecting_.append(pos);
+    if (pos.tm - collecting_.tm_.front() < period_)
+        return;
+
+    if (pending_)
+    {
+        ready_.append(collecting_);
+        collecting_.clear();
+        return;
+    }
+
+    std::swap(collecting_, ready_);
+    collecting_.clear();
+    pending_ = true;
+    QCoreApplication::postEvent(receiver, new QEvent(type_));
+}
+
+/// takes the batch that is ready
+/// @return the batch, valid until the next call, null if none is ready
+const ImuBatch* ImuBatcher::take()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!pending_)
+        return nullptr;
+    std::swap(ready_, consumer_);
+    ready_.clear();
+    pending_ = false;
+    return &consumer_;
+}
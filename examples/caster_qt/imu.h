@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cast/cast_def.h>
+#include <mutex>
+#include <vector>
+
+/// timestamped imu history with sensor fusion and frame synchronous interpolation
+/// @details samples may arrive from both the imu stream and the positional data tagged with each frame, duplicates
+///          are dropped by timestamp. orientation is either taken from the probe or fused locally from the gyroscope,
+///          accelerometer and magnetometer using a madgwick filter
+class ImuBuffer
+{
+public:
+    explicit ImuBuffer(int capacity = 4096);
+
+    void setFusion(bool en, double beta = 0.1);
+    void clear();
+    void add(const CusPosInfo& pos);
+    void add(const CusPosInfo* pos, int n);
+    bool empty() const;
+    long long int latest() const;
+    QQuaternion orientation(long long int tm) const;
+    void orientations(const long long int* tm, int n, QQuaternion* out) const;
+
+private:
+    /// single orientation sample
+    struct Sample
+    {
+        long long int tm_;  ///< timestamp in nanoseconds
+        QQuaternion q_;     ///< orientation at the time of the sample
+    };
+
+    void addSample(const CusPosInfo& pos);
+    void fuse(const CusPosInfo& pos, double dt);
+    const Sample& at(int i) const { return samples_[(head_ + i) % samples_.size()]; }
+    int lowerBound(long long int tm, int first) const;
+    QQuaternion interpolate(int i, long long int tm) const;
+
+    mutable std::mutex lock_;       ///< guards the history, samples are added from the api threads
+    std::vector<Sample> samples_;   ///< ring of samples, oldest at head_
+    int head_;                      ///< index of the oldest sample
+    int count_;                     ///< # of valid samples
+    bool fusion_;                   ///< flag to fuse the raw sensor data instead of using the probe's orientation
+    double beta_;                   ///< fusion gain
+    double q_[4];                   ///< fused orientation (w, x, y, z)
+};
+
+/// imu samples in structure of arrays layout
+/// @details each sensor axis is stored contiguously, so reductions and filters run over plain arrays
+struct ImuBatch
+{
+    void clear();
+    void append(const CusPosInfo& pos);
+    void append(const ImuBatch& batch);
+    size_t size() const { return tm_.size(); }
+    bool empty() const { return tm_.empty(); }
+    QVector3D meanGyro() const;
+
+    std::vector<long long int> tm_;     ///< timestamps in nanoseconds
+    std::vector<double> gx_, gy_, gz_;  ///< angular velocity in radians per second
+    std::vector<double> ax_, ay_, az_;  ///< acceleration in g
+    std::vector<double> mx_, my_, mz_;  ///< magnetic field normalized to the earth's field, only its direction is used by the fusion
+    std::vector<double> qw_, qx_, qy_, qz_; ///< orientation reported by the probe
+};
+
+/// collects streamed imu samples into batches
+/// @details the api delivers one sample per callback, at the native imu rate posting an event for each one costs more
+///          than handling the samples. samples are collected until the batch spans the batch period by their
+///          timestamps, then a single event is posted. a batch the gui has not taken yet keeps growing instead of being
+///          replaced, so no samples are lost. a period of 0 delivers every sample
+class ImuBatcher
+{
+public:
+    explicit ImuBatcher(QEvent::Type type);
+
+    void setPeriod(int ms);
+    void add(const CusPosInfo& pos, QObject* receiver);
+    const ImuBatch* take();
+
+private:
+    QEvent::Type type_;         ///< event type posted when a batch is ready
+    std::mutex lock_;           ///< guards the batches, samples are added from the api threads
+    long long int period_;      ///< batch period in nanoseconds
+    ImuBatch collecting_;       ///< batch being filled
+    ImuBatch ready_;            ///< batch waiting for the gui
+    ImuBatch consumer_;         ///< batch held by the gui
+    bool pending_;              ///< flag that an event was posted and the batch not yet taken
+};
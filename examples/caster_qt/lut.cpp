@@ -0,0 +1,120 @@
+#include "lut.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define LUT_AVX2
+#endif
+
+/// default constructor
+DisplayLut::DisplayLut() : gain_(0), gamma_(1), colormap_(Colormap::Gray)
+{
+    rebuild();
+}
+
+/// sets the display gain
+/// @param[in] db the gain in decibels
+void DisplayLut::setGain(double db)
+{
+    if (db == gain_)
+        return;
+    gain_ = db;
+    rebuild();
+}
+
+/// sets the display gamma
+/// @param[in] gamma the gamma exponent, values below 1 brighten the mid tones
+void DisplayLut::setGamma(double gamma)
+{
+    gamma = std::max(gamma, 0.01);
+    if (gamma == gamma_)
+        return;
+    gamma_ = gamma;
+    rebuild();
+}
+
+/// sets the colormap
+/// @param[in] map the colormap
+void DisplayLut::setColormap(Colormap map)
+{
+    if (map == colormap_)
+        return;
+    colormap_ = map;
+    rebuild();
+}
+
+/// maps a normalized intensity through a colormap
+/// @param[in] map the colormap
+/// @param[in] v the intensity in [0, 1]
+/// @return the opaque argb color
+uint32_t DisplayLut::color(Colormap map, double v)
+{
+    double r = v, g = v, b = v;
+    switch (map)
+    {
+    case Colormap::Gray: break;
+    case Colormap::Hot:
+        r = std::min(v * 3.0, 1.0);
+        g = std::clamp(v * 3.0 - 1.0, 0.0, 1.0);
+        b = std::clamp(v * 3.0 - 2.0, 0.0, 1.0);
+        break;
+    case Colormap::Bone:
+        r = (7.0 * v + std::clamp(v * 3.0 - 2.0, 0.0, 1.0)) / 8.0;
+        g = (7.0 * v + std::clamp(v * 3.0 - 1.0, 0.0, 1.0)) / 8.0;
+        b = (7.0 * v + std::min(v * 3.0, 1.0)) / 8.0;
+        break;
+    case Colormap::Sepia:
+        r = std::min(v * 1.07, 1.0);
+        g = v * 0.86;
+        b = v * 0.67;
+        break;
+    }
+    auto c = [](double x) { return static_cast<uint32_t>(std::lround(std::clamp(x, 0.0, 1.0) * 255.0)); };
+    return 0xFF000000u | (c(r) << 16) | (c(g) << 8) | c(b);
+}
+
+/// rebuilds the table from the current settings
+void DisplayLut::rebuild()
+{
+    const double gain = std::pow(10.0, gain_ / 20.0);
+    for (auto i = 0; i < 256; i++)
+    {
+        const double v = std::min(std::pow(i / 255.0, gamma_) * gain, 1.0);
+        table_[i] = color(colormap_, v);
+    }
+}
+
+/// maps a grayscale frame to argb
+/// @param[in] src the 8 bit frame
+/// @param[in] w the frame width
+/// @param[in] h the frame height
+/// @param[in] srcStride bytes per row of the source
+/// @param[out] dst the argb output
+/// @param[in] dstStride bytes per row of the output
+void DisplayLut::apply(const uint8_t* src, int w, int h, int srcStride, uint32_t* dst, int dstStride) const
+{
+    for (auto y = 0; y < h; y++)
+    {
+        const uint8_t* in = src + static_cast<size_t>(y) * srcStride;
+        uint32_t* out = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(dst) + static_cast<size_t>(y) * dstStride);
+        int x = 0;
+#if defined(LUT_AVX2)
+        // widen 8 levels to 32 bit indices and gather their table entries
+        for (; x + 8 <= w; x += 8)
+        {
+            const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + x)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_i32gather_epi32(reinterpret_cast<const int*>(table_), idx, 4));
+        }
+#endif
+        for (; x + 4 <= w; x += 4)
+        {
+            out[x] = table_[in[x]];
+            out[x + 1] = table_[in[x + 1]];
+            out[x + 2] = table_[in[x + 2]];
+            out[x + 3] = table_[in[x + 3]];
+        }
+        for (; x < w; x++)
+            out[x] = table_[in[x]];
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+/// display colormaps for 8 bit grayscale frames
+enum class Colormap
+{
+    Gray,   ///< grayscale
+    Hot,    ///< black, red, yellow, white
+    Bone,   ///< blue tinted grayscale
+    Sepia,  ///< brown tinted grayscale
+};
+
+/// client-side display mapping of 8 bit grayscale frames to argb
+/// @details gain, gamma and colormap are folded into one 256 entry table, so adjusting them only rebuilds the table and
+///          takes effect on the next frame (or immediately on the current one) without a round trip to the scanner.
+///          the table is applied with avx2 gathers where available, and with an unrolled scalar loop otherwise
+class DisplayLut
+{
+public:
+    DisplayLut();
+
+    void setGain(double db);
+    void setGamma(double gamma);
+    void setColormap(Colormap map);
+    double gain() const { return gain_; }
+    double gamma() const { return gamma_; }
+    Colormap colormap() const { return colormap_; }
+    void apply(const uint8_t* src, int w, int h, int srcStride, uint32_t* dst, int dstStride) const;
+    uint32_t operator[](int i) const { return table_[i]; }
+
+private:
+    void rebuild();
+    static uint32_t color(Colormap map, double v);
+
+    double gain_;           ///< gain in decibels
+    double gamma_;          ///< gamma exponent
+    Colormap colormap_;     ///< colormap
+    alignas(32) uint32_t table_[256];   ///< argb output for each input level
+};
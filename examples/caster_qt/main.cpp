@@ -1,13 +1,13 @@
 #include "caster.h"
+#include "format.h"
+#include "imu.h"
+#include "resolution.h"
 #include <memory>
 #include <cast/cast.h>
 #include <iostream>
 
 static std::unique_ptr<Caster> _caster;
-static std::vector<char> _image;
-static std::vector<char> _prescanImage;
 static std::vector<char> _spectrum;
-static std::vector<char> _rfData;
 
 int main(int argc, char *argv[])
 {
@@ -32,46 +32,93 @@ int main(int argc, char *argv[])
     initParams.newProcessedImageFn =
         [](const void* img, const CusProcessedImageInfo* nfo, int npos, const CusPosInfo* pos)
         {
-            int sz = nfo->imageSize;
-            // we need to perform a deep copy of the image data since we have to post the event (yes this happens a lot with this api)
-            if (_image.size() < static_cast<size_t>(sz))
-                _image.resize(sz);
-            std::memcpy(_image.data(), img, sz);
-            QQuaternion imu;
-            imu.setScalar(0.0);
-            if (npos && pos)
-                imu = QQuaternion(static_cast<float>(pos[0].qw), static_cast<float>(pos[0].qx), static_cast<float>(pos[0].qy), static_cast<float>(pos[0].qz));
-
-            QApplication::postEvent(_caster.get(), new event::Image(IMAGE_EVENT, _image.data(), nfo->tm, nfo->width, nfo->height, nfo->bitsPerPixel, sz, imu));
+            // we need to perform a deep copy of the image data since the gui consumes it later (yes this happens a lot with this api)
+            // separated overlays get their own slot so they do not replace the grayscale frame they belong to
+            // loss, jitter and the link quality behind the format and output size are measured on arrival, ahead of the
+            // subscription, so neither a busy gui nor frames dropped on purpose read as a bad link. overlays share the
+            // timestamps of their grayscale frames
+            if (!nfo->overlay)
+            {
+                _caster->imageStats().add(nfo->tm, nfo->fps);
+                _caster->resolution().addFrame(nfo->width, nfo->height, nfo->imageSize, nfo->tm, nfo->micronsPerPixel, nfo->fps);
+                _caster->formatSelector().addFrame(nfo->tm, nfo->imageSize, nfo->width * nfo->height, nfo->format, nfo->fps);
+            }
+            // keep the imu history up to date, also with frames that are not subscribed to
+            _caster->imu().add(pos, npos);
+            // frames the application is not subscribed to are dropped before any copy, overlays follow their grayscale frame
+            if (!_caster->subscription(Stream::Processed).accept(nfo->tm))
+                return;
+            auto& slot = nfo->overlay ? _caster->overlays() : _caster->images();
+            // only the region of interest is copied, its origin is moved so depths and lateral positions keep their meaning
+            const QRect rc = _caster->roi().crop(*nfo);
+            const int bpp = nfo->bitsPerPixel / 8;
+            auto& evt = rc.isEmpty() ? slot.prepare(img, nfo->imageSize) : slot.prepare(img, nfo->width * bpp, rc, bpp);
+            // tag the frame with the orientation at its exact timestamp
+            evt.imu_ = _caster->imu().orientation(nfo->tm);
+            evt.tm_ = nfo->tm;
+            evt.width_ = rc.isEmpty() ? nfo->width : rc.width();
+            evt.height_ = rc.isEmpty() ? nfo->height : rc.height();
+            evt.frameWidth_ = nfo->width;
+            evt.frameHeight_ = nfo->height;
+            evt.frameSize_ = nfo->imageSize;
+            evt.bpp_ = nfo->bitsPerPixel;
+            evt.micronsPerPixel_ = nfo->micronsPerPixel;
+            evt.originX_ = nfo->originX - rc.x() * nfo->micronsPerPixel;
+            evt.originY_ = nfo->originY - rc.y() * nfo->micronsPerPixel;
+            evt.angle_ = nfo->angle;
+            std::memcpy(evt.tgc_, nfo->tgc, sizeof(evt.tgc_));
+            evt.overlay_ = nfo->overlay ? true : false;
+            evt.format_ = nfo->format;
+            evt.fps_ = nfo->fps;
+            slot.publish(_caster.get());
         };
 
     initParams.newRawImageFn =
         [](const void* data, const CusRawImageInfo* nfo, int, const CusPosInfo*)
         {
-            // we need to perform a deep copy of the image data since we have to post the event (yes this happens a lot with this api)
+            // we need to perform a deep copy of the image data since the gui consumes it later (yes this happens a lot with this api)
             int sz = nfo->lines * nfo->samples * (nfo->bitsPerSample / 8);
             if (nfo->rf)
             {
-                if (_rfData.size() < static_cast<size_t>(sz))
-                    _rfData.resize(sz);
-                std::memcpy(_rfData.data(), data, sz);
-                QApplication::postEvent(_caster.get(), new event::RfImage(_rfData.data(), nfo->tm, nfo->lines, nfo->samples, nfo->bitsPerSample, sz, nfo->lateralSize, nfo->axialSize));
+                _caster->rfStats().add(nfo->tm, nfo->fps);
+                if (!_caster->subscription(Stream::Rf).accept(nfo->tm))
+                    return;
+                auto& slot = _caster->rfData();
+                auto& evt = slot.prepare(data, sz);
+                evt.tm_ = nfo->tm;
+                evt.width_ = nfo->lines;
+                evt.height_ = nfo->samples;
+                evt.bpp_ = nfo->bitsPerSample;
+                evt.lateral_ = nfo->lateralSize;
+                evt.axial_ = nfo->axialSize;
+                slot.publish(_caster.get());
             }
             else
             {
                 // image may be a jpeg, adjust the size
                 if (nfo->jpeg)
                     sz = nfo->jpeg;
-                if (_prescanImage.size() < static_cast<size_t>(sz))
-                    _prescanImage.resize(sz);
-                std::memcpy(_prescanImage.data(), data, sz);
-                QApplication::postEvent(_caster.get(), new event::Image(PRESCAN_EVENT, _prescanImage.data(), nfo->tm, nfo->lines, nfo->samples, nfo->bitsPerSample, sz, {}));
+                _caster->prescanStats().add(nfo->tm, nfo->fps);
+                if (!_caster->subscription(Stream::Prescan).accept(nfo->tm))
+                    return;
+                auto& slot = _caster->prescanImages();
+                auto& evt = slot.prepare(data, sz);
+                evt.tm_ = nfo->tm;
+                evt.width_ = nfo->lines;
+                evt.height_ = nfo->samples;
+                evt.bpp_ = nfo->bitsPerSample;
+                evt.micronsPerPixel_ = nfo->axialSize;
+                std::memcpy(evt.tgc_, nfo->tgc, sizeof(evt.tgc_));
+                slot.publish(_caster.get());
             }
         };
 
     initParams.newSpectralImageFn =
         [](const void* img, const CusSpectralImageInfo* nfo)
         {
+            // spectrum blocks carry no timestamp, the subscription works on their arrival times
+            if (!_caster->subscription(Stream::Spectrum).accept())
+                return;
             // we need to perform a deep copy of the image data since we have to post the event (yes this happens a lot with this api)
             int sz = nfo->lines * nfo->samples * (nfo->bitsPerSample / 8);
             if (_spectrum.size() < static_cast<size_t>(sz))
@@ -85,15 +132,23 @@ int main(int argc, char *argv[])
     initParams.newImuDataFn =
         [](const CusPosInfo* pos)
         {
-            QQuaternion imu;
+            // the history is updated right away for frame tagging, the gui is only notified once per batch of subscribed samples
             if (pos)
-                imu = QQuaternion(static_cast<float>(pos->qw), static_cast<float>(pos->qx), static_cast<float>(pos->qy), static_cast<float>(pos->qz));
-            QApplication::postEvent(_caster.get(), new event::Imu(imu));
+            {
+                _caster->imu().add(*pos);
+                if (_caster->subscription(Stream::Imu).accept(pos->tm))
+                    _caster->imuBatches().add(*pos, _caster.get());
+            }
         };
 
     initParams.freezeFn =
         [](int frozen)
         {
+            // the streams pause while frozen, the statistics restart here so frames arriving ahead of the gui update are
+            // not measured against the last frame before the freeze
+            _caster->imageStats().restart();
+            _caster->prescanStats().restart();
+            _caster->rfStats().restart();
             // post event here, as the gui (statusbar) will be updated directly, and it needs to come from the application thread
             QApplication::postEvent(_caster.get(), new event::Freeze(frozen ? true : false));
         };
@@ -0,0 +1,273 @@
+#include "motion.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    /// minimum correlation for a block to contribute to the global estimate
+    const double kMinScore = 0.6;
+    /// minimum template variance (per pixel) for a block to be considered textured
+    const double kMinVariance = 4.0;
+    /// refinement range at each pyramid level after the coarsest one
+    const int kRefineRange = 2;
+    /// smallest block size that will be matched at any pyramid level
+    const int kMinBlock = 4;
+}
+
+/// default constructor
+MotionEstimator::MotionEstimator() : blockSize_(32), searchRange_(32), levels_(3)
+{
+}
+
+/// sets the size of the blocks that are matched
+/// @param[in] sz the block size in pixels at full resolution
+void MotionEstimator::setBlockSize(int sz)
+{
+    blockSize_ = std::max(sz, kMinBlock);
+}
+
+/// sets the maximum frame-to-frame displacement that can be detected
+/// @param[in] range the search range in pixels at full resolution
+void MotionEstimator::setSearchRange(int range)
+{
+    searchRange_ = std::max(range, 1);
+}
+
+/// sets the number of pyramid levels
+/// @param[in] levels the number of levels, 1 disables the pyramid
+void MotionEstimator::setLevels(int levels)
+{
+    levels_ = std::max(levels, 1);
+    reset();
+}
+
+/// discards the previous frame so that the next frame starts a new sequence
+void MotionEstimator::reset()
+{
+    previous_.clear();
+}
+
+/// builds the grayscale image pyramid for a frame
+/// @param[in] frame the frame to process
+/// @param[out] pyr the resulting pyramid, finest level first
+void MotionEstimator::buildPyramid(const QImage& frame, Pyramid& pyr) const
+{
+    const QImage gray = (frame.format() == QImage::Format_Grayscale8) ? frame : frame.convertToFormat(QImage::Format_Grayscale8);
+
+    pyr.resize(levels_);
+    Level& base = pyr[0];
+    base.width_ = gray.width();
+    base.height_ = gray.height();
+    base.pixels_.resize(static_cast<size_t>(base.width_) * base.height_);
+    for (auto y = 0; y < base.height_; y++)
+        std::memcpy(base.pixels_.data() + y * base.width_, gray.constScanLine(y), base.width_);
+
+    for (auto l = 1; l < levels_; l++)
+    {
+        const Level& src = pyr[l - 1];
+        Level& dst = pyr[l];
+        dst.width_ = src.width_ / 2;
+        dst.height_ = src.height_ / 2;
+        dst.pixels_.resize(static_cast<size_t>(dst.width_) * dst.height_);
+        for (auto y = 0; y < dst.height_; y++)
+        {
+            const uint8_t* r0 = src.pixels_.data() + (y * 2) * src.width_;
+            const uint8_t* r1 = r0 + src.width_;
+            uint8_t* out = dst.pixels_.data() + y * dst.width_;
+            for (auto x = 0; x < dst.width_; x++)
+                out[x] = static_cast<uint8_t>((r0[x * 2] + r0[x * 2 + 1] + r1[x * 2] + r1[x * 2 + 1] + 2) >> 2);
+        }
+    }
+}
+
+/// finds the best match of a block from the previous frame within the current frame
+/// @param[in] prev the previous frame
+/// @param[in] cur the current frame
+/// @param[in] x left of the block in the previous frame
+/// @param[in] y top of the block in the previous frame
+/// @param[in] sz size of the block
+/// @param[in,out] shift the initial displacement guess, holds the best displacement on return
+/// @param[in] range the search range around the initial guess
+/// @param[out] subx sub-pixel horizontal refinement of the best displacement
+/// @param[out] suby sub-pixel vertical refinement of the best displacement
+/// @return the normalized cross-correlation of the best match, 0 if the block has no texture
+double MotionEstimator::match(const Level& prev, const Level& cur, int x, int y, int sz, QPoint& shift, int range, double& subx, double& suby) const
+{
+    subx = suby = 0;
+    const double n = static_cast<double>(sz * sz);
+
+    int64_t st = 0, stt = 0;
+    for (auto j = 0; j < sz; j++)
+    {
+        const uint8_t* t = prev.pixels_.data() + (y + j) * prev.width_ + x;
+        for (auto i = 0; i < sz; i++)
+        {
+            st += t[i];
+            stt += t[i] * t[i];
+        }
+    }
+    const double vt = static_cast<double>(stt) - static_cast<double>(st) * st / n;
+    if (vt < kMinVariance * n)
+        return 0;
+
+    const int span = range * 2 + 1;
+    std::vector<double> scores(static_cast<size_t>(span) * span, -1.0);
+    double best = -1.0;
+    QPoint bestShift = shift;
+    for (auto dy = -range; dy <= range; dy++)
+    {
+        const int cy = y + shift.y() + dy;
+        if (cy < 0 || cy + sz > cur.height_)
+            continue;
+        for (auto dx = -range; dx <= range; dx++)
+        {
+            const int cx = x + shift.x() + dx;
+            if (cx < 0 || cx + sz > cur.width_)
+                continue;
+
+            int64_t sc = 0, scc = 0, stc = 0;
+            for (auto j = 0; j < sz; j++)
+            {
+                const uint8_t* t = prev.pixels_.data() + (y + j) * prev.width_ + x;
+                const uint8_t* c = cur.pixels_.data() + (cy + j) * cur.width_ + cx;
+                for (auto i = 0; i < sz; i++)
+                {
+                    sc += c[i];
+                    scc += c[i] * c[i];
+                    stc += t[i] * c[i];
+                }
+            }
+            const double vc = static_cast<double>(scc) - static_cast<double>(sc) * sc / n;
+            if (vc <= 0)
+                continue;
+            const double score = (static_cast<double>(stc) - static_cast<double>(st) * sc / n) / std::sqrt(vt * vc);
+            scores[(dy + range) * span + (dx + range)] = score;
+            if (score > best)
+            {
+                best = score;
+                bestShift = QPoint(shift.x() + dx, shift.y() + dy);
+            }
+        }
+    }
+
+    if (best < 0)
+        return 0;
+
+    // fit a parabola through the peak and its neighbours for sub-pixel accuracy
+    const int bx = bestShift.x() - shift.x() + range, by = bestShift.y() - shift.y() + range;
+    auto refine = [](double l, double c, double r)
+    {
+        const double d = l - 2.0 * c + r;
+        return (l < 0 || r < 0 || d >= 0) ? 0.0 : std::clamp(0.5 * (l - r) / d, -0.5, 0.5);
+    };
+    if (bx > 0 && bx < span - 1)
+        subx = refine(scores[by * span + bx - 1], best, scores[by * span + bx + 1]);
+    if (by > 0 && by < span - 1)
+        suby = refine(scores[(by - 1) * span + bx], best, scores[(by + 1) * span + bx]);
+
+    shift = bestShift;
+    return best;
+}
+
+/// fits a rigid transform (rotation about the frame center plus translation) to the well matched blocks
+/// @param[in,out] field the motion field to update
+/// @param[in] w width of the frame
+/// @param[in] h height of the frame
+void MotionEstimator::estimateRigid(MotionField& field, int w, int h) const
+{
+    const QPointF center(w / 2.0, h / 2.0);
+    QPointF cp, cq;
+    int count = 0;
+    for (const auto& v : field.vectors_)
+    {
+        if (v.score_ < kMinScore)
+            continue;
+        cp += v.pos_ - center;
+        cq += v.pos_ + v.shift_ - center;
+        count++;
+    }
+
+    field.valid_ = (count >= 3);
+    if (!field.valid_)
+        return;
+
+    cp /= count;
+    cq /= count;
+    double a = 0, b = 0;
+    for (const auto& v : field.vectors_)
+    {
+        if (v.score_ < kMinScore)
+            continue;
+        const QPointF p = v.pos_ - center - cp;
+        const QPointF q = v.pos_ + v.shift_ - center - cq;
+        a += p.x() * q.x() + p.y() * q.y();
+        b += p.x() * q.y() - p.y() * q.x();
+    }
+
+    field.rotation_ = std::atan2(b, a);
+    const double c = std::cos(field.rotation_), s = std::sin(field.rotation_);
+    field.translation_ = cq - QPointF(c * cp.x() - s * cp.y(), s * cp.x() + c * cp.y());
+}
+
+/// estimates the motion between the previous frame and a new one
+/// @param[in] frame the new frame, any format convertible to grayscale
+/// @param[in] tm timestamp of the new frame
+/// @param[out] field the resulting motion field
+/// @return true if a motion field was produced, false if there was no previous frame of the same size
+bool MotionEstimator::process(const QImage& frame, long long int tm, MotionField& field)
+{
+    if (frame.isNull())
+        return false;
+
+    Pyramid current;
+    buildPyramid(frame, current);
+
+    const Level& base = current[0];
+    if (previous_.empty() || previous_[0].width_ != base.width_ || previous_[0].height_ != base.height_)
+    {
+        previous_ = std::move(current);
+        return false;
+    }
+
+    field = MotionField();
+    field.tm_ = tm;
+    field.cols_ = base.width_ / blockSize_;
+    field.rows_ = base.height_ / blockSize_;
+    field.vectors_.resize(static_cast<size_t>(field.cols_) * field.rows_);
+
+    // each row of blocks is a tile, matched coarse to fine through the pyramid
+    parallelFor(field.rows_, [&](int row)
+    {
+        for (auto col = 0; col < field.cols_; col++)
+        {
+            MotionVector& v = field.vectors_[row * field.cols_ + col];
+            v.pos_ = QPointF((col + 0.5) * blockSize_, (row + 0.5) * blockSize_);
+            v.score_ = 0;
+
+            QPoint shift(0, 0);
+            double subx = 0, suby = 0;
+            bool coarsest = true;
+            for (auto l = levels_ - 1; l >= 0; l--)
+            {
+                const int sz = blockSize_ >> l;
+                if (sz < kMinBlock)
+                    continue;
+
+                if (!coarsest)
+                    shift *= 2;
+                const int range = coarsest ? (searchRange_ + (1 << l) - 1) >> l : kRefineRange;
+                coarsest = false;
+                v.score_ = match(previous_[l], current[l], (col * blockSize_) >> l, (row * blockSize_) >> l, sz, shift, range, subx, suby);
+                if (v.score_ <= 0)
+                    break;
+            }
+            v.shift_ = (v.score_ > 0) ? QPointF(shift.x() + subx, shift.y() + suby) : QPointF();
+        }
+    });
+
+    estimateRigid(field, base.width_, base.height_);
+    previous_ = std::move(current);
+    return true;
+}
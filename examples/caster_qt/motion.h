@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+/// displacement of a single block between two consecutive frames
+struct MotionVector
+{
+    QPointF pos_;       ///< block center in the previous frame, in pixels
+    QPointF shift_;     ///< displacement into the current frame, in pixels
+    double score_;      ///< normalized cross-correlation of the best match, 0 if the block has no texture
+};
+
+/// motion between two consecutive frames
+struct MotionField
+{
+    MotionField() : tm_(0), cols_(0), rows_(0), rotation_(0), valid_(false) { }
+
+    long long int tm_;      ///< timestamp of the current frame, matches the tm of its processed or pre-scan image info
+    int cols_;              ///< # of blocks in the horizontal direction
+    int rows_;              ///< # of blocks in the vertical direction
+    std::vector<MotionVector> vectors_; ///< per block displacements, row major
+    QPointF translation_;   ///< global rigid translation in pixels
+    double rotation_;       ///< global rigid rotation in radians about the center of the frame
+    bool valid_;            ///< flag that enough blocks matched to produce a global estimate
+};
+
+/// frame-to-frame in-plane motion estimation
+/// @details uses pyramidal block matching with normalized cross-correlation, the blocks of each pyramid level are
+///          split into tiles that are matched across the shared thread pool
+class MotionEstimator
+{
+public:
+    MotionEstimator();
+
+    void setBlockSize(int sz);
+    void setSearchRange(int range);
+    void setLevels(int levels);
+    void reset();
+    bool process(const QImage& frame, long long int tm, MotionField& field);
+
+private:
+    /// single level of the image pyramid
+    struct Level
+    {
+        Level() : width_(0), height_(0) { }
+
+        int width_;                     ///< width in pixels
+        int height_;                    ///< height in pixels
+        std::vector<uint8_t> pixels_;   ///< grayscale pixels, stride is the width
+    };
+    using Pyramid = std::vector<Level>;
+
+    void buildPyramid(const QImage& frame, Pyramid& pyr) const;
+    double match(const Level& prev, const Level& cur, int x, int y, int sz, QPoint& shift, int range, double& subx, double& suby) const;
+    void estimateRigid(MotionField& field, int w, int h) const;
+
+    int blockSize_;     ///< block size in pixels at full resolution
+    int searchRange_;   ///< maximum displacement searched in pixels at full resolution
+    int levels_;        ///< # of pyramid levels
+    Pyramid previous_;  ///< pyramid of the previous frame
+};
@@ -0,0 +1,41 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+/// runs a function over a range of indices using the shared application thread pool
+/// @param[in] n the number of indices to process
+/// @param[in] fn the function to run for each index in [0, n)
+void parallelFor(int n, const std::function<void(int)>& fn)
+{
+    if (n <= 0)
+        return;
+
+    std::atomic_int next(0);
+    QSemaphore done;
+    auto work = [&]()
+    {
+        for (int i = next++; i < n; i = next++)
+            fn(i);
+    };
+
+    // only use threads that are free right now, the caller picks up whatever is left so a busy pool never stalls us
+    auto pool = QThreadPool::globalInstance();
+    const int helpers = std::min(n, pool->maxThreadCount()) - 1;
+    int started = 0;
+    for (auto i = 0; i < helpers; i++)
+    {
+        std::unique_ptr<QRunnable> task(QRunnable::create([&]()
+        {
+            work();
+            done.release();
+        }));
+        if (!pool->tryStart(task.get()))
+            break;
+        task.release();
+        started++;
+    }
+
+    work();
+    done.acquire(started);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <functional>
+
+/// runs a function over a range of indices using the shared application thread pool
+/// @param[in] n the number of indices to process
+/// @param[in] fn the function to run for each index in [0, n)
+/// @note the calling thread takes part in the work and the call blocks until every index has been processed
+void parallelFor(int n, const std::function<void(int)>& fn);
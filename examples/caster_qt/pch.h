@@ -19,6 +19,12 @@
 #include <Qt3DCore/Qt3DCore>
 #include <Qt3DRender/Qt3DRender>
 #include <Qt3DExtras/Qt3DExtras>
+#include <Qt3DLogic/Qt3DLogic>
+#ifdef CASTER_OPENGL
+    #include <QtOpenGL/QOpenGLTexture>
+    #include <QtOpenGL/QOpenGLTextureBlitter>
+    #include <QtOpenGLWidgets/QOpenGLWidget>
+#endif
 
 #ifdef __clang__
     #pragma clang diagnostic pop
@@ -0,0 +1,242 @@
+#include "reconnect.h"
+#include <cast/cast.h>
+
+namespace
+{
+    /// shortest gap in the frames treated as a dropped link, in milliseconds
+    const int kMinStall = 300;
+    /// gap in frame intervals treated as a dropped link, for slow frame rates
+    const double kStallIntervals = 5.0;
+    /// watchdog period in milliseconds
+    const int kWatchdog = 50;
+    /// first and longest delay between attempts, in milliseconds
+    const int kMinBackoff = 50;
+    const int kMaxBackoff = 2000;
+    /// time allowed for the library to answer a disconnect or connect request, in milliseconds
+    const int kRequestTimeout = 1500;
+
+    /// the library takes plain function callbacks, only one session exists at a time
+    ReconnectManager* _reconnect = nullptr;
+}
+
+/// default constructor
+/// @param[in] parent the parent object
+ReconnectManager::ReconnectManager(QObject* parent) : QObject(parent), enabled_(false), active_(false), frozen_(false), state_(State::Idle), port_(0), interval_(0),
+    backoff_(kMinBackoff), attempts_(0), reconnects_(0), lastLatency_(0), lastArrivals_(0)
+{
+    _reconnect = this;
+    watchdog_.setInterval(kWatchdog);
+    connect(&watchdog_, &QTimer::timeout, this, &ReconnectManager::check);
+    retry_.setSingleShot(true);
+    connect(&retry_, &QTimer::timeout, this, &ReconnectManager::retry);
+}
+
+/// destructor
+ReconnectManager::~ReconnectManager()
+{
+    _reconnect = nullptr;
+}
+
+/// enables or disables automatic reconnection
+/// @param[in] en the enable state
+void ReconnectManager::setEnabled(bool en)
+{
+    enabled_ = en;
+    if (!en && recovering())
+    {
+        retry_.stop();
+        state_ = State::Idle;
+    }
+}
+
+/// starts monitoring a connection made by the user
+/// @param[in] ip the address of the scanner
+/// @param[in] port the cast port of the scanner
+void ReconnectManager::start(const QString& ip, unsigned int port)
+{
+    ip_ = ip;
+    port_ = port;
+    interval_ = 0;
+    active_ = true;
+    frozen_ = false;
+    state_ = State::Idle;
+}
+
+/// stops monitoring, called when the user disconnects
+void ReconnectManager::stop()
+{
+    active_ = false;
+    state_ = State::Idle;
+    watchdog_.stop();
+    retry_.stop();
+    attempts_ = 0;
+}
+
+/// tracks the freeze state, frames are only expected while imaging
+/// @param[in] en the freeze state
+void ReconnectManager::setFrozen(bool en)
+{
+    frozen_ = en;
+    // a scanner that comes back frozen is recovered as well, it will not send frames
+    if (state_ == State::Resuming && en)
+        finish();
+    if (recovering())
+        return;
+    state_ = (en || !active_) ? State::Idle : State::Streaming;
+    if (state_ == State::Idle)
+        watchdog_.stop();
+    else
+    {
+        sinceFrame_.start();
+        watchdog_.start();
+    }
+}
+
+/// accounts for a received frame
+/// @param[in] fps the frame rate reported with the frame
+void ReconnectManager::frameReceived(double fps)
+{
+    if (fps > 0)
+    {
+        const double interval = 1000.0 / fps;
+        interval_ = (interval_ > 0) ? interval_ + 0.1 * (interval - interval_) : interval;
+    }
+
+    if (state_ == State::Resuming)
+        finish();
+    // frames arriving after connecting show that the scanner is imaging, even without a freeze notification
+    else if (state_ == State::Idle && active_ && !frozen_)
+    {
+        state_ = State::Streaming;
+        watchdog_.start();
+    }
+    if (state_ == State::Streaming)
+        sinceFrame_.start();
+}
+
+/// sets a count of the frames received from the library
+/// @param[in] fn returns the count, called from the gui thread
+/// @details frames that are received but not delivered to the gui, for example because of a stream subscription, then
+///          still show that the link is alive
+void ReconnectManager::setArrivals(std::function<unsigned long long()> fn)
+{
+    arrivals_ = std::move(fn);
+    lastArrivals_ = arrivals_ ? arrivals_() : 0;
+}
+
+/// completes the recovery
+void ReconnectManager::finish()
+{
+    // the outage started at the last frame before the gap, which is when sinceFrame_ was last restarted
+    lastLatency_ = static_cast<double>(sinceFrame_.nsecsElapsed()) / 1e6;
+    reconnects_++;
+    retry_.stop();
+    attempts_ = 0;
+    state_ = frozen_ ? State::Idle : State::Streaming;
+    if (frozen_)
+        watchdog_.stop();
+    emit recovered(lastLatency_);
+}
+
+/// checks for a gap in the frames
+void ReconnectManager::check()
+{
+    if (arrivals_ && active_)
+    {
+        const auto n = arrivals_();
+        if (n != lastArrivals_)
+        {
+            lastArrivals_ = n;
+            frameReceived(0);
+        }
+    }
+
+    if (!enabled_ || state_ != State::Streaming || ip_.isEmpty())
+        return;
+
+    const double stall = std::max(static_cast<double>(kMinStall), kStallIntervals * interval_);
+    if (sinceFrame_.elapsed() < stall)
+        return;
+
+    emit lost();
+    backoff_ = kMinBackoff;
+    attempts_ = 0;
+    release();
+}
+
+/// releases the session held by the library, which is needed before connecting again
+void ReconnectManager::release()
+{
+    state_ = State::Disconnecting;
+    retry_.start(kRequestTimeout);
+    if (castDisconnect([](int)
+    {
+        if (_reconnect)
+            QMetaObject::invokeMethod(_reconnect, &ReconnectManager::onDisconnected, Qt::QueuedConnection);
+    }) < 0)
+        onDisconnected();
+}
+
+/// called once the dropped session is released
+void ReconnectManager::onDisconnected()
+{
+    if (state_ != State::Disconnecting)
+        return;
+    // the first attempt is made right away, the following ones back off
+    if (!attempts_)
+    {
+        attempt();
+        return;
+    }
+    state_ = State::Waiting;
+    retry_.start(backoff_);
+    backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+}
+
+/// makes a connection attempt
+void ReconnectManager::attempt()
+{
+    attempts_++;
+    state_ = State::Connecting;
+    retry_.start(kRequestTimeout);
+    if (castConnect(ip_.toStdString().c_str(), port_, "research", [](int imagePort, int imuPort, int)
+    {
+        if (_reconnect)
+            QMetaObject::invokeMethod(_reconnect, [imagePort, imuPort]() { _reconnect->onConnected(imagePort, imuPort); }, Qt::QueuedConnection);
+    }) < 0)
+        retry();
+}
+
+/// handles a request that timed out, or the end of the backoff delay
+void ReconnectManager::retry()
+{
+    switch (state_)
+    {
+    // the library did not answer, go on as if the session was released
+    case State::Disconnecting: onDisconnected(); break;
+    // the attempt failed or the connection does not deliver frames, start over
+    case State::Connecting:
+    case State::Resuming: release(); break;
+    case State::Waiting: attempt(); break;
+    default: break;
+    }
+}
+
+/// handles the result of a connection attempt
+/// @param[in] imagePort the image port, negative on failure
+/// @param[in] imuPort the imu port
+void ReconnectManager::onConnected(int imagePort, int imuPort)
+{
+    if (state_ != State::Connecting)
+        return;
+    retry_.stop();
+    if (imagePort <= 0)
+    {
+        release();
+        return;
+    }
+    // a connection that does not deliver frames is retried as well
+    state_ = State::Resuming;
+    retry_.start(kRequestTimeout);
+    emit resumed(imagePort, imuPort);
+}
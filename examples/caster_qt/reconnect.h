@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+
+/// restores a dropped connection without user intervention
+/// @details while imaging, a gap in the frames longer than a few frame intervals is treated as a dropped link. the
+///          session is torn down and reconnected with exponential backoff, and once the scanner accepts the connection
+///          the application reapplies its stream settings. buffers, threads and measurements of the application are left
+///          untouched, so streaming continues where it stopped. the time from the last frame before the outage to the
+///          first frame after it is reported as the reconnect latency
+class ReconnectManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ReconnectManager(QObject* parent = nullptr);
+    ~ReconnectManager() override;
+
+    void setEnabled(bool en);
+    bool enabled() const { return enabled_; }
+    void start(const QString& ip, unsigned int port);
+    void stop();
+    void setFrozen(bool en);
+    void frameReceived(double fps);
+    void setArrivals(std::function<unsigned long long()> fn);
+    bool recovering() const { return state_ != State::Idle && state_ != State::Streaming; }
+    int reconnects() const { return reconnects_; }
+    double lastLatency() const { return lastLatency_; }
+
+signals:
+    void lost();
+    void resumed(int imagePort, int imuPort);
+    void recovered(double latency);
+
+private:
+    enum class State
+    {
+        Idle,           ///< not connected, or no frames received since imaging started
+        Streaming,      ///< frames are expected
+        Disconnecting,  ///< tearing down the dropped session
+        Waiting,        ///< backing off before the next attempt
+        Connecting,     ///< connection attempt in progress
+        Resuming,       ///< connected, waiting for the first frame
+    };
+
+    void check();
+    void release();
+    void attempt();
+    void finish();
+    void retry();
+    void onDisconnected();
+    void onConnected(int imagePort, int imuPort);
+
+private:
+    bool enabled_;              ///< flag that dropped connections are restored automatically
+    bool active_;               ///< flag that a connection made by the user is monitored
+    bool frozen_;               ///< freeze state of the scanner
+    State state_;               ///< recovery state
+    QString ip_;                ///< address of the scanner
+    unsigned int port_;         ///< cast port of the scanner
+    double interval_;           ///< smoothed frame interval in milliseconds
+    int backoff_;               ///< delay before the next attempt in milliseconds
+    int attempts_;              ///< # of attempts in the current outage
+    int reconnects_;            ///< # of outages recovered from
+    double lastLatency_;        ///< duration of the last recovered outage in milliseconds
+    QElapsedTimer sinceFrame_;  ///< time since the latest frame
+    std::function<unsigned long long()> arrivals_;  ///< counts the frames received from the library, if set
+    unsigned long long lastArrivals_;   ///< arrival count at the previous check
+    QTimer watchdog_;           ///< checks for gaps in the frames
+    QTimer retry_;              ///< schedules the next attempt, and times out pending ones
+};
@@ -0,0 +1,225 @@
+#include "resolution.h"
+#include <cast/cast.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /// time to wait for resizing to settle in milliseconds
+    const int kDebounce = 300;
+    /// relative change in pixel count required to renegotiate
+    const double kThreshold = 0.15;
+    /// finest pixel spacing worth requesting, finer pixels only interpolate the acquisition
+    const double kMinMicronsPerPixel = 50.0;
+    /// smallest output size requested
+    const int kMinWidth = 160;
+    const int kMinHeight = 120;
+    /// largest output size requested
+    const int kMaxWidth = 4096;
+    const int kMaxHeight = 4096;
+    /// smallest displayed part of the frame that raises the output size
+    const double kMinCrop = 0.1;
+    /// # of frames between throughput driven re-evaluations
+    const int kEvaluationFrames = 60;
+    /// weight of new measurements in the running averages
+    const double kSmoothing = 0.1;
+    /// share of the target frame rate below which the link falls short
+    const double kLowRate = 0.9;
+    /// share of the target frame rate above which the link has headroom
+    const double kHighRate = 0.97;
+    /// # of windows with headroom required before the budget is raised
+    const int kStepUpWindows = 3;
+    /// # of windows with headroom after which the budget is raised even if the peak throughput does not promise it
+    const int kProbeWindows = 15;
+    /// growth of the budget in pixels when stepping up
+    const double kStepUp = 1.25;
+    /// share of the peak throughput a raised budget may use
+    const double kHeadroom = 0.7;
+}
+
+/// default constructor
+/// @param[in] parent the parent object
+ResolutionManager::ResolutionManager(QObject* parent) : QObject(parent), crop_(1, 1), micronsPerPixel_(0), bytesPerPixel_(0), rate_(0),
+    throughput_(0), peakThroughput_(0), targetRate_(0), budget_(0), goodWindows_(0), lastTime_(0), frames_(0)
+{
+    debounce_.setSingleShot(true);
+    debounce_.setInterval(kDebounce);
+    connect(&debounce_, &QTimer::timeout, this, &ResolutionManager::negotiate);
+}
+
+/// records a new display size, the output size is negotiated once resizing settles
+/// @param[in] sz the display size
+void ResolutionManager::setDisplaySize(const QSize& sz)
+{
+    display_ = sz;
+    debounce_.start();
+}
+
+/// sets the part of the frame that is displayed, such as a cropped region of interest
+/// @param[in] fraction width and height of the displayed part relative to the frame, 1 for the whole frame
+void ResolutionManager::setCrop(const QSizeF& fraction)
+{
+    const QSizeF crop(std::clamp(fraction.width(), kMinCrop, 1.0), std::clamp(fraction.height(), kMinCrop, 1.0));
+    const double change = std::abs(crop.width() * crop.height() - crop_.width() * crop_.height()) / (crop_.width() * crop_.height());
+    crop_ = crop;
+    // small changes, such as rounding of the cropped pixels, are left to the periodic re-evaluation
+    if (change >= kThreshold && !display_.isEmpty())
+        debounce_.start();
+}
+
+/// forgets the link measurements, should be called when connecting to a new scanner
+void ResolutionManager::reset()
+{
+    output_ = QSize();
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        frame_ = QSize();
+        micronsPerPixel_ = bytesPerPixel_ = rate_ = throughput_ = peakThroughput_ = targetRate_ = budget_ = 0;
+        lastTime_ = 0;
+        frames_ = goodWindows_ = 0;
+    }
+    if (!display_.isEmpty())
+        debounce_.start();
+}
+
+/// updates the link measurements with a received frame
+/// @param[in] w the frame width
+/// @param[in] h the frame height
+/// @param[in] bytes the size of the frame as transmitted
+/// @param[in] tm the frame timestamp in nanoseconds
+/// @param[in] micronsPerPixel the frame resolution
+/// @param[in] fps the acquisition frame rate, the output size is chosen to hold it
+/// @details called from the api thread as frames arrive, so frames the gui was too busy to display still count
+void ResolutionManager::addFrame(int w, int h, int bytes, long long int tm, double micronsPerPixel, double fps)
+{
+    if (w <= 0 || h <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (fps > 0)
+        targetRate_ = fps;
+    frame_ = QSize(w, h);
+    if (micronsPerPixel > 0)
+        micronsPerPixel_ = micronsPerPixel;
+
+    const double bpp = static_cast<double>(bytes) / (static_cast<double>(w) * h);
+    bytesPerPixel_ = (bytesPerPixel_ > 0) ? bytesPerPixel_ + kSmoothing * (bpp - bytesPerPixel_) : bpp;
+
+    if (lastTime_ && tm > lastTime_)
+    {
+        const double rate = 1e9 / static_cast<double>(tm - lastTime_);
+        rate_ = (rate_ > 0) ? rate_ + kSmoothing * (rate - rate_) : rate;
+        const double throughput = rate * bytes;
+        throughput_ = (throughput_ > 0) ? throughput_ + kSmoothing * (throughput - throughput_) : throughput;
+        peakThroughput_ = std::max(peakThroughput_, throughput_);
+    }
+    lastTime_ = tm;
+
+    // throughput changes are picked up periodically on the gui thread
+    if (++frames_ >= kEvaluationFrames)
+    {
+        frames_ = 0;
+        updateBudget();
+        QMetaObject::invokeMethod(this, &ResolutionManager::evaluate, Qt::QueuedConnection);
+    }
+}
+
+/// updates the pixel budget with the latest window of link measurements, called with the lock held
+void ResolutionManager::updateBudget()
+{
+    if (rate_ <= 0 || bytesPerPixel_ <= 0 || targetRate_ <= 0)
+        return;
+
+    // falling short while the link runs at its highest measured throughput fits the budget to what it carries now
+    if (rate_ < targetRate_ * kLowRate && throughput_ >= peakThroughput_ * 0.8)
+    {
+        const double budget = throughput_ / (targetRate_ * bytesPerPixel_);
+        budget_ = (budget_ > 0) ? std::min(budget_, budget) : budget;
+        goodWindows_ = 0;
+        return;
+    }
+
+    if (budget_ <= 0 || rate_ < targetRate_ * kHighRate)
+    {
+        goodWindows_ = 0;
+        return;
+    }
+
+    // step up once the rate held, if the larger size is expected to fit with some headroom, or after a longer wait
+    // otherwise, since the peak throughput was measured at the smaller sizes and may understate the link
+    ++goodWindows_;
+    const double needed = budget_ * kStepUp * bytesPerPixel_ * targetRate_;
+    if ((goodWindows_ >= kStepUpWindows && needed < peakThroughput_ * kHeadroom) || goodWindows_ >= kProbeWindows)
+    {
+        budget_ *= kStepUp;
+        if (budget_ >= static_cast<double>(kMaxWidth) * kMaxHeight)
+            budget_ = 0;
+        goodWindows_ = 0;
+    }
+}
+
+/// re-evaluates the output size with the latest link measurements, unless a resize is about to be handled anyways
+void ResolutionManager::evaluate()
+{
+    if (!debounce_.isActive())
+        negotiate();
+}
+
+/// calculates the best output size for the current conditions
+/// @return the output size
+QSize ResolutionManager::choose() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    // the displayed part of the frame should fill the display
+    double w = display_.width() / crop_.width(), h = display_.height() / crop_.height();
+    double scale = 1.0;
+
+    // pixels finer than the useful spacing add no detail, the display upscales instead
+    if (micronsPerPixel_ > 0 && frame_.width() > 0)
+    {
+        const double spacing = micronsPerPixel_ * frame_.width() / w;
+        if (spacing < kMinMicronsPerPixel)
+            scale = spacing / kMinMicronsPerPixel;
+    }
+
+    // keep within the pixels the link was found to carry at the target frame rate
+    if (budget_ > 0)
+    {
+        const double pixels = w * h * scale * scale;
+        if (pixels > budget_)
+            scale *= std::sqrt(budget_ / pixels);
+    }
+
+    scale = std::min({ scale, kMaxWidth / w, kMaxHeight / h });
+
+    // keep the aspect ratio and even dimensions
+    const int ow = std::max(kMinWidth, static_cast<int>(w * scale) & ~1);
+    const int oh = std::max(kMinHeight, static_cast<int>(h * scale) & ~1);
+    return QSize(ow, oh);
+}
+
+/// requests a new output size from the scanner if the change is worth it
+void ResolutionManager::negotiate()
+{
+    if (display_.isEmpty())
+        return;
+
+    const QSize target = choose();
+    if (target == output_)
+        return;
+
+    if (!output_.isEmpty())
+    {
+        const double current = static_cast<double>(output_.width()) * output_.height();
+        const double next = static_cast<double>(target.width()) * target.height();
+        const bool aspect = std::abs(static_cast<double>(target.width()) / target.height() - static_cast<double>(output_.width()) / output_.height()) > 0.01;
+        if (!aspect && std::abs(next - current) / current < kThreshold)
+            return;
+    }
+
+    if (castSetOutputSize(target.width(), target.height()) < 0)
+        return;
+
+    output_ = target;
+    emit outputSizeChanged(output_);
+}
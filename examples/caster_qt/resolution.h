@@ -0,0 +1,54 @@
+#pragma once
+
+#include <mutex>
+
+/// chooses the output image size requested from the scanner
+/// @details display resizes are debounced so interactive resizing does not flood the connection, the display scales
+///          the last frames locally in the meantime. the size follows the display, but is limited to what the imaging
+///          resolution can fill and to what the measured link throughput can carry at the target frame rate. once the
+///          frame rate falls short on a saturated link, the pixels the link carried are kept as a budget that caps every
+///          later size, and the budget is only raised after the frame rate held for several windows, so a size that
+///          restored the frame rate is not given up again on the next evaluation. a new
+///          size is only negotiated when it differs enough from the current one to be worth the reconfiguration. when
+///          only part of the image is displayed, the size is raised so that part fills the display. the link is measured
+///          from the api thread as frames arrive, against the acquisition frame rate the scanner reports, so a busy gui
+///          does not read as a slow link. the size is negotiated from the gui thread
+class ResolutionManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ResolutionManager(QObject* parent = nullptr);
+
+    void setDisplaySize(const QSize& sz);
+    void setCrop(const QSizeF& fraction);
+    void addFrame(int w, int h, int bytes, long long int tm, double micronsPerPixel, double fps);
+    void reset();
+    QSize outputSize() const { return output_; }
+
+signals:
+    void outputSizeChanged(const QSize& sz);
+
+private:
+    void evaluate();
+    void negotiate();
+    QSize choose() const;
+    void updateBudget();
+
+private:
+    mutable std::mutex lock_;   ///< guards the link measurements, frames are added from the api thread
+    QTimer debounce_;           ///< delays negotiation until resizing settles
+    QSize display_;             ///< latest display size
+    QSize output_;              ///< last negotiated output size
+    QSize frame_;               ///< size of the latest received frame
+    QSizeF crop_;               ///< displayed part of the frame, relative to its size
+    double micronsPerPixel_;    ///< resolution of the latest received frame
+    double bytesPerPixel_;      ///< average encoded size per pixel
+    double rate_;               ///< average frame rate
+    double throughput_;         ///< average link throughput in bytes per second
+    double peakThroughput_;     ///< highest average throughput seen, used as the link capacity
+    double targetRate_;         ///< acquisition frame rate the size is chosen for
+    double budget_;             ///< # of pixels the link carries at the target frame rate, 0 until a shortfall was seen
+    int goodWindows_;           ///< consecutive windows that held the target frame rate under the budget
+    long long int lastTime_;    ///< timestamp of the latest frame in nanoseconds
+    int frames_;                ///< # of frames since the last negotiation
+};
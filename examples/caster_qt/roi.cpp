@@ -0,0 +1,77 @@
+#include "roi.h"
+#include <cmath>
+
+/// default constructor
+RegionOfInterest::RegionOfInterest() : active_(false), units_(Units::Pixels)
+{
+}
+
+/// sets the region, frames are cropped from then on
+/// @param[in] region the region, in pixels or in microns from the image origin
+/// @param[in] units the units of the region
+void RegionOfInterest::set(const QRectF& region, Units units)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    region_ = region.normalized();
+    units_ = units;
+    active_ = !region_.isEmpty();
+}
+
+/// stops cropping, frames are delivered whole
+void RegionOfInterest::clear()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    active_ = false;
+}
+
+/// @return true if frames are cropped
+bool RegionOfInterest::active() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return active_;
+}
+
+/// @return the units of the region
+RegionOfInterest::Units RegionOfInterest::units() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return units_;
+}
+
+/// calculates the pixels to keep from a frame
+/// @param[in] nfo the frame information
+/// @return the pixels to keep, within the frame, empty if the frame should be delivered whole, which includes regions
+///         entirely outside of the frame
+QRect RegionOfInterest::crop(const CusProcessedImageInfo& nfo) const
+{
+    if (nfo.format != Uncompressed && nfo.format != Uncompressed8Bit)
+        return QRect();
+    if (nfo.width <= 0 || nfo.height <= 0 || nfo.imageSize != nfo.width * nfo.height * (nfo.bitsPerPixel / 8))
+        return QRect();
+
+    QRectF region;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!active_)
+            return QRect();
+        region = region_;
+        if (units_ == Units::Microns)
+        {
+            if (nfo.micronsPerPixel <= 0)
+                return QRect();
+            // the pixel at column c, row r lies at (c * mpp - originX, r * mpp - originY) microns
+            region = QRectF((region.x() + nfo.originX) / nfo.micronsPerPixel, (region.y() + nfo.originY) / nfo.micronsPerPixel,
+                            region.width() / nfo.micronsPerPixel, region.height() / nfo.micronsPerPixel);
+        }
+    }
+
+    const int x0 = static_cast<int>(std::floor(region.left()));
+    const int y0 = static_cast<int>(std::floor(region.top()));
+    const int x1 = static_cast<int>(std::ceil(region.right()));
+    const int y1 = static_cast<int>(std::ceil(region.bottom()));
+    const QRect rc = QRect(QPoint(x0, y0), QPoint(x1 - 1, y1 - 1)).intersected(QRect(0, 0, nfo.width, nfo.height));
+    // a region covering the whole frame needs no crop
+    if (rc.isEmpty() || rc.size() == QSize(nfo.width, nfo.height))
+        return QRect();
+    return rc;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cast/cast_def.h>
+#include <mutex>
+
+/// region of interest cropped from the processed images
+/// @details the scanner always transmits the full frame, so the region is cut out in the image callback while the
+///          frame is copied, and only the region is copied and delivered to the gui. the origin of the cropped frame is
+///          moved so that depths and lateral positions keep their meaning, the pixel spacing is unchanged. a region
+///          given in microns is relative to the image origin (lateral, depth), and keeps covering the same anatomy when
+///          the output size changes, which allows requesting a larger output size so the region is seen in full detail.
+///          a region given in pixels refers to the output image as transmitted. only uncompressed formats are cropped,
+///          compressed frames are delivered whole. the region is set from the gui and applied from the api threads
+class RegionOfInterest
+{
+public:
+    /// units of the region
+    enum class Units
+    {
+        Pixels,     ///< pixels of the transmitted image
+        Microns,    ///< microns from the image origin
+    };
+
+    RegionOfInterest();
+
+    void set(const QRectF& region, Units units);
+    void clear();
+    bool active() const;
+    Units units() const;
+    QRect crop(const CusProcessedImageInfo& nfo) const;
+
+private:
+    mutable std::mutex lock_;   ///< guards the region
+    bool active_;               ///< flag that frames are cropped
+    QRectF region_;             ///< the region
+    Units units_;               ///< units of the region
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// holds the latest frame of a stream between the api thread and the gui thread
+/// @details frames are copied into one of three buffers that rotate between the api thread (producer), the frame
+///          waiting to be displayed (pending) and the frame being displayed (consumer). a notification is only posted
+///          when no frame is pending, frames that arrive while one is still pending replace it and are counted as
+///          skipped, so a stalled gui never replays a backlog and display latency stays bounded by one frame.
+///          the event objects that carry the frame attributes rotate with the buffers and are reused
+/// @tparam E the event type carrying the frame attributes, must be constructible from its event type
+template <class E>
+class FrameSlot
+{
+public:
+    /// default constructor
+    /// @param[in] type the event type posted to notify the receiver
+    explicit FrameSlot(QEvent::Type type) : type_(type), pending_(false), skipped_(0)
+    {
+        producer_.event_ = std::make_unique<E>(type);
+        waiting_.event_ = std::make_unique<E>(type);
+        consumer_.event_ = std::make_unique<E>(type);
+    }
+
+    /// copies a new frame into the producer buffer, called from the api thread
+    /// @param[in] data the frame data
+    /// @param[in] sz size of the frame data in bytes
+    /// @return the reusable event to fill in with the frame attributes, its data and size are already set
+    E& prepare(const void* data, int sz)
+    {
+        if (producer_.data_.size() < static_cast<size_t>(sz))
+            producer_.data_.resize(sz);
+        std::memcpy(producer_.data_.data(), data, sz);
+        producer_.event_->data_ = producer_.data_.data();
+        producer_.event_->size_ = sz;
+        return *producer_.event_;
+    }
+
+    /// copies part of a new frame into the producer buffer, called from the api thread
+    /// @param[in] data the frame data
+    /// @param[in] stride bytes per row of the frame
+    /// @param[in] rc the part to copy, in pixels
+    /// @param[in] bpp bytes per pixel
+    /// @return the reusable event to fill in with the frame attributes, its data and size are already set to the part
+    E& prepare(const void* data, int stride, const QRect& rc, int bpp)
+    {
+        const int row = rc.width() * bpp;
+        const int sz = row * rc.height();
+        if (producer_.data_.size() < static_cast<size_t>(sz))
+            producer_.data_.resize(sz);
+        const char* src = static_cast<const char*>(data) + static_cast<size_t>(rc.y()) * stride + static_cast<size_t>(rc.x()) * bpp;
+        for (int y = 0; y < rc.height(); y++)
+            std::memcpy(producer_.data_.data() + static_cast<size_t>(y) * row, src + static_cast<size_t>(y) * stride, row);
+        producer_.event_->data_ = producer_.data_.data();
+        producer_.event_->size_ = sz;
+        return *producer_.event_;
+    }
+
+    /// publishes the prepared frame, called from the api thread
+    /// @param[in] receiver the object to notify
+    void publish(QObject* receiver)
+    {
+        bool notify = false;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            std::swap(producer_, waiting_);
+            notify = !pending_;
+            pending_ = true;
+        }
+
+        if (notify)
+            QCoreApplication::postEvent(receiver, new QEvent(type_));
+        else
+            skipped_++;
+    }
+
+    /// takes the latest frame, called from the gui thread
+    /// @return the frame, valid until the next call, null if there is no new frame
+    const E* take()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!pending_)
+            return nullptr;
+
+        std::swap(consumer_, waiting_);
+        pending_ = false;
+        return consumer_.event_.get();
+    }
+
+    /// hands the data of the taken frame over to the caller, called from the gui thread after take
+    /// @return the frame data sized to the frame, the taken event no longer refers to it
+    std::vector<char> release()
+    {
+        std::vector<char> data;
+        std::swap(data, consumer_.data_);
+        data.resize(static_cast<size_t>(consumer_.event_->size_));
+        consumer_.event_->data_ = nullptr;
+        return data;
+    }
+
+    /// gives the slot a buffer in place of a released one, called from the gui thread
+    /// @param[in] data the buffer, any size, an empty one is grown when the slot rotates it back to the producer
+    void recycle(std::vector<char>&& data)
+    {
+        if (consumer_.data_.empty())
+            consumer_.data_ = std::move(data);
+    }
+
+    /// retrieves the number of frames that were replaced before being displayed
+    /// @return the skipped frame count
+    quint64 skipped() const { return skipped_; }
+
+private:
+    /// frame buffer along with the event describing it
+    struct Frame
+    {
+        std::vector<char> data_;    ///< frame data
+        std::unique_ptr<E> event_;  ///< frame attributes
+    };
+
+    QEvent::Type type_;         ///< notification event type
+    std::mutex lock_;           ///< guards the pending frame
+    Frame producer_;            ///< frame being written by the api thread
+    Frame waiting_;             ///< latest complete frame
+    Frame consumer_;            ///< frame being displayed
+    bool pending_;              ///< flag that the latest complete frame has not been taken
+    std::atomic<quint64> skipped_;  ///< # of frames replaced before being taken
+};
@@ -0,0 +1,168 @@
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /// tolerance of the reported frame rate before it counts as a change
+    const double kRateTolerance = 0.05;
+    /// upper limits of the transit variation bins in milliseconds
+    const double kJitterLimits[StreamStats::kJitterBins - 1] = { 1, 2, 5, 10, 20, 50, 100 };
+    /// upper limits of the lost run length bins
+    const unsigned long long kGapLimits[StreamStats::kGapBins - 1] = { 1, 2, 5, 10 };
+    /// timestamp step in nanoseconds beyond which the stream is taken to have paused rather than to have lost frames
+    const long long int kPause = 2000000000LL;
+    /// # of gaps remembered for late frames
+    const size_t kRecentGaps = 16;
+}
+
+/// default constructor
+StreamStats::StreamStats()
+{
+    reset();
+}
+
+/// clears the counters, called when a new connection starts
+void StreamStats::reset()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    counters_ = Counters{};
+    lastTime_ = 0;
+    lastTransit_ = 0;
+    restart_ = false;
+    recentGaps_.clear();
+    start_ = std::chrono::steady_clock::now();
+}
+
+/// restarts the sequence with the next frame while keeping the counters, called when the scanner freezes or resumes
+/// so that the time spent frozen is not counted as lost frames
+void StreamStats::restart()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    restart_ = true;
+}
+
+/// starts a new sequence, the lock must be held
+/// @param[in] tm the frame timestamp in nanoseconds
+/// @param[in] fps the frame rate reported with the frame
+/// @param[in] arrival the local arrival time in milliseconds
+void StreamStats::start(long long int tm, double fps, double arrival)
+{
+    counters_.frames_++;
+    counters_.sequence_++;
+    counters_.fps_ = fps;
+    lastTime_ = tm;
+    lastTransit_ = arrival - static_cast<double>(tm) * 1e-6;
+    restart_ = false;
+    recentGaps_.clear();
+}
+
+/// accounts for a received frame
+/// @param[in] tm the frame timestamp in nanoseconds
+/// @param[in] fps the frame rate reported with the frame
+void StreamStats::add(long long int tm, double fps)
+{
+    const double arrival = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+
+    std::lock_guard<std::mutex> lock(lock_);
+    Counters& c = counters_;
+
+    if (!c.frames_ || restart_)
+    {
+        start(tm, fps, arrival);
+        return;
+    }
+
+    if (tm < lastTime_)
+    {
+        c.reordered_++;
+        // a late frame that falls into a gap was counted as lost when the gap was found
+        for (auto& g : recentGaps_)
+        {
+            if (g.missing_ && tm > g.from_ && tm < g.to_)
+            {
+                g.missing_--;
+                c.lost_--;
+                break;
+            }
+        }
+        return;
+    }
+    if (tm == lastTime_)
+    {
+        c.duplicates_++;
+        return;
+    }
+
+    // a pause in the timestamps, such as a freeze that was not reported in time, is not loss
+    if (tm - lastTime_ > kPause)
+    {
+        start(tm, fps, arrival);
+        return;
+    }
+
+    const bool rateChange = fps > 0 && c.fps_ > 0 && std::abs(fps - c.fps_) > kRateTolerance * c.fps_;
+    if (rateChange)
+        c.rateChanges_++;
+
+    // steps are measured in intervals of the previous rate, after a rate change the step is not attributed to loss
+    unsigned long long step = 1;
+    if (c.fps_ > 0)
+    {
+        const double intervals = static_cast<double>(tm - lastTime_) * 1e-9 * c.fps_;
+        step = std::max(1ull, static_cast<unsigned long long>(std::llround(intervals)));
+    }
+    if (step > 1 && !rateChange)
+    {
+        const unsigned long long missing = step - 1;
+        c.lost_ += missing;
+        recentGaps_.push_back({ lastTime_, tm, missing });
+        if (recentGaps_.size() > kRecentGaps)
+            recentGaps_.pop_front();
+        int bin = 0;
+        while (bin < kGapBins - 1 && missing > kGapLimits[bin])
+            bin++;
+        c.gaps_[bin]++;
+    }
+
+    const double transit = arrival - static_cast<double>(tm) * 1e-6;
+    const double d = std::abs(transit - lastTransit_);
+    c.jitter_ += (d - c.jitter_) / 16.0;
+    int bin = 0;
+    while (bin < kJitterBins - 1 && d > kJitterLimits[bin])
+        bin++;
+    c.jitters_[bin]++;
+
+    c.frames_++;
+    c.sequence_ += step;
+    c.fps_ = fps;
+    lastTime_ = tm;
+    lastTransit_ = transit;
+}
+
+/// retrieves the counters
+/// @return a consistent snapshot of the counters
+StreamStats::Counters StreamStats::counters() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return counters_;
+}
+
+/// retrieves the label of a transit variation bin
+/// @param[in] i the bin index
+/// @return the label
+QString StreamStats::jitterBin(int i)
+{
+    return (i < kJitterBins - 1) ? QStringLiteral("<%1 ms").arg(kJitterLimits[i]) : QStringLiteral(">%1 ms").arg(kJitterLimits[kJitterBins - 2]);
+}
+
+/// retrieves the label of a lost run length bin
+/// @param[in] i the bin index
+/// @return the label
+QString StreamStats::gapBin(int i)
+{
+    if (i >= kGapBins - 1)
+        return QStringLiteral(">%1").arg(kGapLimits[kGapBins - 2]);
+    const unsigned long long lo = i ? kGapLimits[i - 1] + 1 : 1;
+    return (lo == kGapLimits[i]) ? QString::number(lo) : QStringLiteral("%1-%2").arg(lo).arg(kGapLimits[i]);
+}
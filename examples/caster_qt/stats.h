@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+/// arrival statistics of one stream
+/// @details the scanner does not number its frames, so a sequence number is derived from the frame timestamps and the
+///          reported frame rate: a timestamp step of n frame intervals advances the sequence by n and counts n - 1
+///          frames as lost, while a change of the reported frame rate is counted separately and not as loss. frames
+///          with an older or equal timestamp are counted as reordered or duplicated, a reordered frame that fills a
+///          recent gap is taken back out of the lost frames. the sequence restarts after a freeze and after a pause in
+///          the timestamps, neither of which is loss. jitter is the smoothed variation of
+///          the transit time between the scanner timestamp and the local arrival time, computed as in rtp (rfc 3550),
+///          so it reflects the network and the receive path only. frames skipped later by a busy gui are not counted
+///          here. counters are updated from the api threads and read from the gui
+class StreamStats
+{
+public:
+    static const int kGapBins = 5;      ///< lost run lengths of 1, 2, 3-5, 6-10 and more
+    static const int kJitterBins = 8;   ///< transit variations up to 1, 2, 5, 10, 20, 50, 100 ms and more
+
+    /// snapshot of the counters
+    struct Counters
+    {
+        unsigned long long frames_;     ///< frames received in order
+        unsigned long long sequence_;   ///< derived sequence number of the latest frame
+        unsigned long long lost_;       ///< frames missing between received timestamps
+        unsigned long long reordered_;  ///< frames older than a frame already received
+        unsigned long long duplicates_; ///< frames repeating the latest timestamp
+        unsigned long long rateChanges_;    ///< changes of the reported frame rate
+        double jitter_;                 ///< smoothed transit variation in milliseconds
+        double fps_;                    ///< latest reported frame rate
+        std::array<unsigned long long, kGapBins> gaps_;         ///< histogram of lost run lengths
+        std::array<unsigned long long, kJitterBins> jitters_;   ///< histogram of transit variations
+    };
+
+    StreamStats();
+
+    void add(long long int tm, double fps);
+    void restart();
+    void reset();
+    Counters counters() const;
+    static QString jitterBin(int i);
+    static QString gapBin(int i);
+
+private:
+    /// frames found missing between two received timestamps
+    struct Gap
+    {
+        long long int from_;            ///< timestamp before the gap
+        long long int to_;              ///< timestamp after the gap
+        unsigned long long missing_;    ///< # of frames still missing
+    };
+
+    void start(long long int tm, double fps, double arrival);
+
+private:
+    mutable std::mutex lock_;   ///< guards the counters, frames are added from the api threads
+    Counters counters_;         ///< running counters
+    long long int lastTime_;    ///< timestamp of the latest in order frame
+    double lastTransit_;        ///< transit time of the latest in order frame, in milliseconds
+    bool restart_;              ///< flag that the next frame starts a new sequence
+    std::deque<Gap> recentGaps_;    ///< latest gaps, which late frames may still fill
+    std::chrono::steady_clock::time_point start_;   ///< local reference for arrival times
+};
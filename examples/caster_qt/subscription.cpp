@@ -0,0 +1,120 @@
+#include "subscription.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace
+{
+    /// marks an unset timestamp
+    const long long int kNone = std::numeric_limits<long long int>::min();
+}
+
+/// default constructor
+StreamSubscription::StreamSubscription() : enabled_(true), decimation_(1), interval_(0)
+{
+    reset();
+}
+
+/// restarts the schedule and clears the counters, called when a new connection starts
+void StreamSubscription::reset()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    count_ = 0;
+    next_ = kNone;
+    lastTime_ = kNone;
+    period_ = 0;
+    lastAccepted_ = false;
+    dropped_ = 0;
+}
+
+/// pauses or resumes the stream
+/// @param[in] en the enable state
+void StreamSubscription::setEnabled(bool en)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    enabled_ = en;
+    lastTime_ = kNone;
+}
+
+/// @return true if the stream is delivered
+bool StreamSubscription::enabled() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return enabled_;
+}
+
+/// sets the decimation
+/// @param[in] n only every nth frame is delivered, 1 delivers every frame
+void StreamSubscription::setDecimation(int n)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    decimation_ = std::max(n, 1);
+    count_ = 0;
+    lastTime_ = kNone;
+}
+
+/// caps the delivered frame rate
+/// @param[in] hz the maximum rate, 0 for no cap
+void StreamSubscription::setMaxRate(double hz)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    interval_ = (hz > 0) ? static_cast<long long int>(1e9 / hz) : 0;
+    next_ = kNone;
+    lastTime_ = kNone;
+}
+
+/// decides whether a frame is delivered
+/// @param[in] tm the frame timestamp in nanoseconds
+/// @return true if the frame should be delivered to the gui
+bool StreamSubscription::accept(long long int tm)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (tm == lastTime_)
+    {
+        if (!lastAccepted_)
+            dropped_++;
+        return lastAccepted_;
+    }
+    // the smoothed interval of the incoming frames gives the tolerance of the schedule
+    if (lastTime_ != kNone && tm > lastTime_)
+        period_ = period_ ? period_ + (tm - lastTime_ - period_) / 8 : tm - lastTime_;
+    lastTime_ = tm;
+
+    bool ok = enabled_;
+    if (ok && decimation_ > 1)
+    {
+        ok = (count_ == 0);
+        count_ = (count_ + 1) % decimation_;
+    }
+    if (ok && interval_ > 0)
+    {
+        // timestamps jumping back, such as after reconnecting, restart the schedule
+        if (next_ == kNone || next_ - tm > 2 * interval_)
+            next_ = tm;
+        // frames up to half an incoming interval early still take their slot, so timestamp jitter does not skip a frame
+        if (tm + period_ / 2 < next_)
+            ok = false;
+        else
+            // keep to the schedule while frames arrive in time, so late frames do not push the following ones back
+            next_ = (tm - next_ < interval_) ? next_ + interval_ : tm + interval_;
+    }
+
+    lastAccepted_ = ok;
+    if (!ok)
+        dropped_++;
+    return ok;
+}
+
+/// decides whether a frame without a timestamp is delivered, the local arrival time is used instead
+/// @return true if the frame should be delivered to the gui
+bool StreamSubscription::accept()
+{
+    return accept(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// @return the # of frames withheld from the gui since the connection started
+unsigned long long StreamSubscription::dropped() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return dropped_;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <mutex>
+
+/// streams delivered by the library
+enum class Stream
+{
+    Processed,  ///< scan converted images and their separated overlays
+    Prescan,    ///< pre-scan converted images
+    Rf,         ///< rf data
+    Spectrum,   ///< m and pw spectrum blocks
+    Imu,        ///< streamed imu samples
+    Count
+};
+
+/// delivery settings of one stream
+/// @details the library decodes and calls back for every stream that has a callback, and the scanner offers no way to
+///          select streams, so the subscription is checked first thing in the callbacks. frames that are not wanted are
+///          then dropped before they are copied or posted, and cost nothing in the gui. a stream can be paused, reduced
+///          to every nth frame, and capped to a maximum rate, which is applied to the frame timestamps on a fixed
+///          schedule so the delivered rate neither drifts below the cap nor loses frames to timestamp jitter. frames
+///          sharing a timestamp, such as separated overlays and their grayscale frame, share the decision made for the
+///          first of them. arrival statistics and the link measurements that choose the stream format and output size are
+///          taken before the subscription and still count every frame. settings are changed from the gui and checked
+///          from the api threads
+class StreamSubscription
+{
+public:
+    StreamSubscription();
+
+    void setEnabled(bool en);
+    void setDecimation(int n);
+    void setMaxRate(double hz);
+    bool enabled() const;
+    bool accept(long long int tm);
+    bool accept();
+    unsigned long long dropped() const;
+    void reset();
+
+private:
+    mutable std::mutex lock_;   ///< guards the settings and the schedule
+    bool enabled_;              ///< flag that the stream is delivered
+    int decimation_;            ///< only every nth frame is delivered
+    long long int interval_;    ///< shortest interval between delivered frames in nanoseconds, 0 for no cap
+    int count_;                 ///< frames since the last one kept by the decimation
+    long long int next_;        ///< earliest timestamp of the next delivered frame
+    long long int lastTime_;    ///< timestamp of the latest decision
+    long long int period_;      ///< smoothed interval of the incoming frames in nanoseconds
+    bool lastAccepted_;         ///< the latest decision
+    unsigned long long dropped_;    ///< # of frames withheld from the gui
+};
@@ -0,0 +1,182 @@
+#include "tgc.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define TGC_SSE2
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define TGC_NEON
+#endif
+
+namespace
+{
+    /// dynamic range of the displayed b-mode in decibels, unless set otherwise
+    const double kDefaultRange = 60.0;
+}
+
+/// default constructor
+TgcNormalizer::TgcNormalizer() : reference_(0), range_(kDefaultRange), rows_(0), micronsPerRow_(0), originY_(0)
+{
+    std::memset(tgc_, 0, sizeof(tgc_));
+}
+
+/// sets the gain that intensities are normalized to
+/// @param[in] db the reference gain in decibels
+void TgcNormalizer::setReference(double db)
+{
+    if (db == reference_)
+        return;
+
+    reference_ = db;
+    rows_ = 0;
+}
+
+/// sets the dynamic range of the frames, which converts gain in decibels to gray levels
+/// @param[in] db the dynamic range in decibels spanned from black to white
+void TgcNormalizer::setDynamicRange(double db)
+{
+    if (db <= 0 || db == range_)
+        return;
+
+    range_ = db;
+    rows_ = 0;
+}
+
+/// interpolates the tgc curve
+/// @param[in] tgc the tgc points, ordered by depth, unused trailing points have a depth that does not increase
+/// @param[in] depth the depth in millimeters
+/// @return the gain in decibels at the depth
+double TgcNormalizer::interpolate(const CusTgcInfo* tgc, double depth)
+{
+    int n = 1;
+    while (n < CUS_MAXTGC && tgc[n].depth > tgc[n - 1].depth)
+        n++;
+
+    if (depth <= tgc[0].depth)
+        return tgc[0].gain;
+    for (auto i = 1; i < n; i++)
+    {
+        if (depth <= tgc[i].depth)
+        {
+            const double t = (depth - tgc[i - 1].depth) / (tgc[i].depth - tgc[i - 1].depth);
+            return tgc[i - 1].gain + t * (tgc[i].gain - tgc[i - 1].gain);
+        }
+    }
+    return tgc[n - 1].gain;
+}
+
+/// rebuilds the correction table if the tgc or the geometry changed
+/// @param[in] tgc the tgc points supplied with the frame
+/// @param[in] rows # of rows in the frame (samples per line for pre-scan data)
+/// @param[in] micronsPerRow axial size of a row in microns (the axial size of a sample for pre-scan data)
+/// @param[in] originY vertical origin of the frame in microns, the depth of the first row is -originY
+/// @return true if the table was rebuilt
+bool TgcNormalizer::update(const CusTgcInfo* tgc, int rows, double micronsPerRow, double originY)
+{
+    if (!tgc || rows <= 0 || micronsPerRow <= 0)
+        return false;
+
+    if (rows == rows_ && micronsPerRow == micronsPerRow_ && originY == originY_ && !std::memcmp(tgc, tgc_, sizeof(tgc_)))
+        return false;
+
+    std::memcpy(tgc_, tgc, sizeof(tgc_));
+    rows_ = rows;
+    micronsPerRow_ = micronsPerRow;
+    originY_ = originY;
+
+    // log compression maps the dynamic range linearly onto the gray levels, a gain change is a constant shift
+    const double levels = 255.0 / range_;
+    offsets_.resize(rows);
+    for (auto r = 0; r < rows; r++)
+    {
+        const double depth = std::max(0.0, (r * micronsPerRow - originY) / 1000.0);
+        offsets_[r] = static_cast<int16_t>(std::clamp(std::lround((reference_ - interpolate(tgc_, depth)) * levels), -255L, 255L));
+    }
+    return true;
+}
+
+/// retrieves the correction applied to a row
+/// @param[in] row the row index
+/// @return the gray level offset, 0 if the table has not been built
+int TgcNormalizer::offset(int row) const
+{
+    return (row >= 0 && row < static_cast<int>(offsets_.size())) ? offsets_[row] : 0;
+}
+
+/// applies the correction to raw image data in place
+/// @param[in,out] data the image data
+/// @param[in] w width of the image in pixels
+/// @param[in] h height of the image in rows, should match the table
+/// @param[in] bpp bits per pixel, 8 for grayscale or 32 for argb (colored pixels and alpha are left untouched)
+/// @param[in] stride bytes per row
+void TgcNormalizer::apply(uint8_t* data, int w, int h, int bpp, int stride) const
+{
+    if (!data || (bpp != 8 && bpp != 32) || offsets_.empty())
+        return;
+
+    const int bytes = w * (bpp / 8);
+    const int rows = std::min(h, static_cast<int>(offsets_.size()));
+    for (auto r = 0; r < rows; r++)
+    {
+        uint8_t* px = data + r * stride;
+        const int o = offsets_[r];
+        if (!o)
+            continue;
+
+        const uint8_t d = static_cast<uint8_t>(std::abs(o));
+        int i = 0;
+#if defined(TGC_SSE2)
+        const __m128i delta = _mm_set1_epi8(static_cast<char>(d));
+        const __m128i low = _mm_set1_epi32(0xFF);
+        for (; i + 16 <= bytes; i += 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(px + i));
+            const __m128i res = (o > 0) ? _mm_adds_epu8(v, delta) : _mm_subs_epu8(v, delta);
+            if (bpp == 8)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(px + i), res);
+                continue;
+            }
+            // a pixel is gray when blue equals green and green equals red, the mask then covers its three color bytes
+            const __m128i eq = _mm_cmpeq_epi8(v, _mm_srli_epi32(v, 8));
+            const __m128i gray = _mm_and_si128(_mm_and_si128(eq, _mm_srli_epi32(eq, 8)), low);
+            const __m128i mask = _mm_or_si128(gray, _mm_or_si128(_mm_slli_epi32(gray, 8), _mm_slli_epi32(gray, 16)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(px + i), _mm_or_si128(_mm_and_si128(mask, res), _mm_andnot_si128(mask, v)));
+        }
+#elif defined(TGC_NEON)
+        const uint8x16_t delta = vdupq_n_u8(d);
+        const uint32x4_t low = vdupq_n_u32(0xFF);
+        for (; i + 16 <= bytes; i += 16)
+        {
+            const uint8x16_t v = vld1q_u8(px + i);
+            const uint8x16_t res = (o > 0) ? vqaddq_u8(v, delta) : vqsubq_u8(v, delta);
+            if (bpp == 8)
+            {
+                vst1q_u8(px + i, res);
+                continue;
+            }
+            const uint32x4_t eq = vreinterpretq_u32_u8(vceqq_u8(v, vreinterpretq_u8_u32(vshrq_n_u32(vreinterpretq_u32_u8(v), 8))));
+            const uint32x4_t gray = vandq_u32(vandq_u32(eq, vshrq_n_u32(eq, 8)), low);
+            const uint32x4_t mask = vorrq_u32(gray, vorrq_u32(vshlq_n_u32(gray, 8), vshlq_n_u32(gray, 16)));
+            vst1q_u8(px + i, vbslq_u8(vreinterpretq_u8_u32(mask), res, v));
+        }
+#endif
+        if (bpp == 8)
+        {
+            for (; i < bytes; i++)
+                px[i] = static_cast<uint8_t>(std::clamp(px[i] + o, 0, 255));
+        }
+        else
+        {
+            for (; i + 4 <= bytes; i += 4)
+            {
+                if (px[i] != px[i + 1] || px[i + 1] != px[i + 2])
+                    continue;
+                px[i] = px[i + 1] = px[i + 2] = static_cast<uint8_t>(std::clamp(px[i] + o, 0, 255));
+            }
+        }
+    }
+}
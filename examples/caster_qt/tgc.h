@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cast/cast_def.h>
+#include <vector>
+
+/// removes the time gain compensation applied on the probe to produce quantitative intensities
+/// @details frames are log compressed, so a change of gain in decibels shifts the gray levels by a fixed amount that
+///          follows from the displayed dynamic range. the tgc curve is expanded into a per-row offset table which is
+///          cached until the tgc points or the geometry change, the table is then applied with simd to the received
+///          frame, ahead of the display mapping and of overlay compositing. in 32 bit frames only gray pixels are
+///          corrected, colored pixels such as doppler or a colormap applied on the scanner are not echo amplitudes
+class TgcNormalizer
+{
+public:
+    TgcNormalizer();
+
+    void setReference(double db);
+    void setDynamicRange(double db);
+    bool update(const CusTgcInfo* tgc, int rows, double micronsPerRow, double originY = 0);
+    void apply(uint8_t* data, int w, int h, int bpp, int stride) const;
+    int offset(int row) const;
+
+private:
+    static double interpolate(const CusTgcInfo* tgc, double depth);
+
+    double reference_;              ///< gain in decibels that intensities are normalized to
+    double range_;                  ///< dynamic range in decibels spanned by the 256 gray levels
+    CusTgcInfo tgc_[CUS_MAXTGC];    ///< tgc points the table was built from
+    int rows_;                      ///< # of rows the table was built for
+    double micronsPerRow_;          ///< row spacing the table was built for
+    double originY_;                ///< vertical origin the table was built for
+    std::vector<int16_t> offsets_;  ///< per row correction in gray levels
+};
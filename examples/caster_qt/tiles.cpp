@@ -0,0 +1,243 @@
+#include "tiles.h"
+#include <cmath>
+
+namespace
+{
+    /// # of frames a tile queues before dropping the oldest
+    const size_t kQueueDepth = 2;
+    /// render loop period in milliseconds
+    const int kRenderPeriod = 16;
+    /// weight of new measurements in the average latency
+    const double kSmoothing = 0.1;
+}
+
+/// default constructor
+/// @param[in] parent the parent widget
+TiledView::TiledView(QWidget* parent) : QWidget(parent), generation_(0)
+{
+    decoders_.setMaxThreadCount(std::max(QThread::idealThreadCount() / 2, 1));
+    connect(&render_, &QTimer::timeout, this, &TiledView::render);
+    render_.start(kRenderPeriod);
+    connect(&rates_, &QTimer::timeout, this, &TiledView::updateRates);
+    rates_.start(1000);
+    setTiles(1);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+}
+
+/// destructor
+TiledView::~TiledView()
+{
+    // decodes post their results back to this object, they have to finish first
+    decoders_.waitForDone();
+}
+
+/// sets the # of tiles, existing tiles are kept
+/// @param[in] n the # of tiles
+void TiledView::setTiles(int n)
+{
+    n = std::max(n, 1);
+    if (n == tiles())
+        return;
+
+    generation_++;
+    tiles_.resize(n);
+    for (auto i = 0; i < n; i++)
+    {
+        tiles_[i].decoding_ = false;
+        if (tiles_[i].name_.isEmpty())
+            tiles_[i].name_ = QStringLiteral("Tile %1").arg(i + 1);
+    }
+    update();
+}
+
+/// sets the name displayed in a tile
+/// @param[in] tile the tile index
+/// @param[in] name the name
+void TiledView::setName(int tile, const QString& name)
+{
+    if (tile < 0 || tile >= tiles())
+        return;
+    tiles_[tile].name_ = name;
+    tiles_[tile].dirty_ = true;
+}
+
+/// clears the image and queue of a tile
+/// @param[in] tile the tile index
+void TiledView::clear(int tile)
+{
+    if (tile < 0 || tile >= tiles())
+        return;
+    Tile& t = tiles_[tile];
+    t.queue_.clear();
+    t.image_ = QImage();
+    t.fresh_ = false;
+    t.fps_ = t.latency_ = 0;
+    t.dirty_ = true;
+}
+
+/// queues a new frame for a tile, called from the gui thread
+/// @param[in] tile the tile index
+/// @param[in] data the frame data, raw or jpeg, taken over by the tile
+/// @param[in] w the frame width
+/// @param[in] h the frame height
+/// @param[in] bpp bits per pixel
+/// @return a recycled buffer for the caller to receive the next frame into, empty if the tile has none spare
+std::vector<char> TiledView::push(int tile, std::vector<char>&& data, int w, int h, int bpp)
+{
+    if (tile < 0 || tile >= tiles() || data.empty())
+        return std::move(data);
+
+    Tile& t = tiles_[tile];
+    // a slow tile drops its oldest frames rather than falling behind
+    while (t.queue_.size() >= kQueueDepth)
+    {
+        t.pool_.push_back(std::move(t.queue_.front().data_));
+        t.queue_.pop_front();
+        t.dropped_++;
+    }
+
+    Frame f;
+    f.data_ = std::move(data);
+    f.width_ = w;
+    f.height_ = h;
+    f.bpp_ = bpp;
+    f.received_ = Clock::now();
+    t.queue_.push_back(std::move(f));
+    decode(tile);
+
+    std::vector<char> spare;
+    if (!t.pool_.empty())
+    {
+        spare = std::move(t.pool_.back());
+        t.pool_.pop_back();
+    }
+    return spare;
+}
+
+/// starts decoding the next queued frame of a tile, one decode runs per tile at a time
+/// @param[in] tile the tile index
+void TiledView::decode(int tile)
+{
+    Tile& t = tiles_[tile];
+    if (t.decoding_ || t.queue_.empty())
+        return;
+
+    t.decoding_ = true;
+    auto frame = std::make_shared<Frame>(std::move(t.queue_.front()));
+    t.queue_.pop_front();
+    const quint64 generation = generation_;
+    decoders_.start(QRunnable::create([this, tile, generation, frame]()
+    {
+        QImage image;
+        const int sz = static_cast<int>(frame->data_.size());
+        if (sz == frame->width_ * frame->height_ * (frame->bpp_ / 8) && (frame->bpp_ == 32 || frame->bpp_ == 8))
+        {
+            image = QImage(frame->width_, frame->height_, frame->bpp_ == 32 ? QImage::Format_ARGB32 : QImage::Format_Grayscale8);
+            for (auto y = 0; y < frame->height_; y++)
+                std::memcpy(image.scanLine(y), frame->data_.data() + y * frame->width_ * (frame->bpp_ / 8), frame->width_ * (frame->bpp_ / 8));
+        }
+        else
+            image.loadFromData(reinterpret_cast<const uchar*>(frame->data_.data()), sz);
+
+        QMetaObject::invokeMethod(this, [this, tile, generation, image, frame]()
+        {
+            decoded(tile, generation, image, std::move(frame->data_), frame->received_);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+/// called on the gui thread when a frame was decoded
+/// @param[in] tile the tile index
+/// @param[in] generation the tile generation the decode was started in
+/// @param[in] image the decoded image
+/// @param[in] buffer the frame buffer, returned to the tile's pool
+/// @param[in] received time the frame was received
+void TiledView::decoded(int tile, quint64 generation, QImage image, std::vector<char> buffer, Clock::time_point received)
+{
+    if (generation != generation_ || tile >= tiles())
+        return;
+
+    Tile& t = tiles_[tile];
+    t.decoding_ = false;
+    t.pool_.push_back(std::move(buffer));
+    if (!image.isNull())
+    {
+        t.image_ = std::move(image);
+        t.shown_ = received;
+        t.fresh_ = true;
+        t.dirty_ = true;
+    }
+    decode(tile);
+}
+
+/// shared render loop, repaints once if any tile changed
+void TiledView::render()
+{
+    bool dirty = false;
+    for (const auto& t : tiles_)
+        dirty |= t.dirty_;
+    if (dirty)
+        update();
+}
+
+/// updates the displayed frame rates
+void TiledView::updateRates()
+{
+    for (auto& t : tiles_)
+    {
+        t.fps_ = t.counted_;
+        t.counted_ = 0;
+        t.dirty_ = true;
+    }
+}
+
+/// calculates the area of a tile, tiles are laid out in a grid as close to square as possible
+/// @param[in] tile the tile index
+/// @return the tile area
+QRect TiledView::tileRect(int tile) const
+{
+    const int n = tiles();
+    const int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(n))));
+    const int rows = (n + cols - 1) / cols;
+    const int w = width() / cols, h = height() / rows;
+    return QRect((tile % cols) * w, (tile / cols) * h, w, h);
+}
+
+/// draws all tiles
+/// @param[in] e the paint event
+void TiledView::paintEvent(QPaintEvent* e)
+{
+    Q_UNUSED(e)
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    painter.setFont(QFont(QStringLiteral("Arial"), 9));
+
+    const auto now = Clock::now();
+    for (auto i = 0; i < tiles(); i++)
+    {
+        Tile& t = tiles_[i];
+        const QRect r = tileRect(i).adjusted(1, 1, -1, -1);
+        if (!t.image_.isNull())
+        {
+            // fit the image into the tile keeping its aspect ratio
+            const QSize fit = t.image_.size().scaled(r.size(), Qt::KeepAspectRatio);
+            const QRect target(r.center() - QPoint(fit.width() / 2, fit.height() / 2), fit);
+            painter.drawImage(target, t.image_);
+        }
+        if (t.fresh_)
+        {
+            const double latency = std::chrono::duration<double, std::milli>(now - t.shown_).count();
+            t.latency_ = (t.frames_) ? t.latency_ + kSmoothing * (latency - t.latency_) : latency;
+            t.frames_++;
+            t.counted_++;
+            t.fresh_ = false;
+        }
+        t.dirty_ = false;
+
+        painter.setPen(QColor(64, 64, 64));
+        painter.drawRect(r);
+        painter.setPen(Qt::white);
+        painter.drawText(r.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop,
+            QStringLiteral("%1\n%2 fps, %3 ms, %4 dropped").arg(t.name_).arg(t.fps_, 0, 'f', 0).arg(t.latency_, 0, 'f', 1).arg(t.dropped_));
+    }
+}
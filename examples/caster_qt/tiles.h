@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+/// tiled live view of several image streams
+/// @details every tile owns a small queue of received frames and the image it displays. frames are decoded on one
+///          thread pool shared by all tiles, and a single timer repaints every tile that changed in one pass, so the
+///          cost grows with the total # of pixels rather than with the # of views
+class TiledView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TiledView(QWidget* parent);
+    ~TiledView() override;
+
+    void setTiles(int n);
+    int tiles() const { return static_cast<int>(tiles_.size()); }
+    void setName(int tile, const QString& name);
+    std::vector<char> push(int tile, std::vector<char>&& data, int w, int h, int bpp);
+    void clear(int tile);
+
+protected:
+    virtual void paintEvent(QPaintEvent* e) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// received frame waiting to be decoded
+    struct Frame
+    {
+        std::vector<char> data_;    ///< encoded or raw frame data
+        int width_;                 ///< frame width
+        int height_;                ///< frame height
+        int bpp_;                   ///< bits per pixel of raw frames
+        Clock::time_point received_;    ///< time the frame was received
+    };
+
+    /// single view with its own queue, image and statistics
+    struct Tile
+    {
+        QString name_;              ///< name displayed in the tile
+        std::deque<Frame> queue_;   ///< frames waiting to be decoded
+        std::vector<std::vector<char>> pool_;   ///< recycled frame buffers
+        QImage image_;              ///< latest decoded frame
+        bool decoding_ = false;     ///< flag that a frame is being decoded
+        bool fresh_ = false;        ///< flag that a new frame has not been painted yet
+        bool dirty_ = false;        ///< flag that the tile has to be repainted
+        Clock::time_point shown_;   ///< receive time of the decoded frame
+        quint64 frames_ = 0;        ///< # of frames displayed
+        quint64 dropped_ = 0;       ///< # of frames dropped from the queue
+        int counted_ = 0;           ///< # of frames displayed since the last rate update
+        double fps_ = 0;            ///< display frame rate
+        double latency_ = 0;        ///< average time from reception to display in milliseconds
+    };
+
+    void decode(int tile);
+    void decoded(int tile, quint64 generation, QImage image, std::vector<char> buffer, Clock::time_point received);
+    void render();
+    void updateRates();
+    QRect tileRect(int tile) const;
+
+private:
+    std::vector<Tile> tiles_;   ///< the tiles
+    QThreadPool decoders_;      ///< decode threads shared by all tiles
+    QTimer render_;             ///< shared render loop
+    QTimer rates_;              ///< updates the frame rates once a second
+    quint64 generation_;        ///< incremented when the tiles change, stale decodes are discarded
+};
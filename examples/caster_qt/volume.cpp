@@ -0,0 +1,220 @@
+#include "volume.h"
+#include "parallel.h"
+#include <cmath>
+
+/// default constructor
+/// @param[in] voxelSize the voxel size in millimeters
+VolumeCompounder::VolumeCompounder(double voxelSize) : voxelSize_(voxelSize), empty_(true)
+{
+}
+
+/// sets the voxel size, discarding any compounded data
+/// @param[in] mm the voxel size in millimeters
+void VolumeCompounder::setVoxelSize(double mm)
+{
+    if (mm <= 0)
+        return;
+
+    voxelSize_ = mm;
+    reset();
+}
+
+/// discards all compounded data
+void VolumeCompounder::reset()
+{
+    std::unique_lock<std::shared_mutex> lock(bricksLock_);
+    bricks_.clear();
+    minimum_ = maximum_ = QVector3D();
+    empty_ = true;
+}
+
+/// packs brick coordinates into a single key
+/// @param[in] bx brick x index
+/// @param[in] by brick y index
+/// @param[in] bz brick z index
+/// @return the brick key
+uint64_t VolumeCompounder::brickKey(int bx, int by, int bz)
+{
+    const uint64_t offset = 1 << 20, mask = (1 << 21) - 1;
+    return ((static_cast<uint64_t>(bx + offset) & mask) << 42) | ((static_cast<uint64_t>(by + offset) & mask) << 21) | (static_cast<uint64_t>(bz + offset) & mask);
+}
+
+/// looks up an allocated brick
+/// @param[in] key the brick key
+/// @return the brick, null if it has not been allocated
+std::shared_ptr<VolumeCompounder::Brick> VolumeCompounder::findBrick(uint64_t key) const
+{
+    std::shared_lock<std::shared_mutex> lock(bricksLock_);
+    auto it = bricks_.find(key);
+    return (it == bricks_.end()) ? nullptr : it->second;
+}
+
+/// looks up a brick, allocating it if required
+/// @param[in] key the brick key
+/// @return the brick
+std::shared_ptr<VolumeCompounder::Brick> VolumeCompounder::brick(uint64_t key)
+{
+    if (auto b = findBrick(key))
+        return b;
+
+    std::unique_lock<std::shared_mutex> lock(bricksLock_);
+    auto& b = bricks_[key];
+    if (!b)
+        b = std::make_shared<Brick>();
+    return b;
+}
+
+/// inserts a frame into the volume
+/// @param[in] frame the received frame, any format convertible to grayscale
+/// @param[in] micronsPerPixel the frame's pixel size
+/// @param[in] originX the frame's horizontal origin in microns
+/// @param[in] originY the frame's vertical origin in microns
+/// @param[in] angle the acquisition angle in degrees for volumetric data, tilts the frame about its lateral axis
+/// @param[in] orientation the probe orientation at the time of the frame
+/// @param[in] position the probe position in millimeters, if known
+/// @note black pixels are treated as outside of the field of view and are not inserted
+void VolumeCompounder::insert(const QImage& frame, double micronsPerPixel, double originX, double originY, double angle,
+    const QQuaternion& orientation, const QVector3D& position)
+{
+    if (frame.isNull() || micronsPerPixel <= 0)
+        return;
+
+    const QImage gray = (frame.format() == QImage::Format_Grayscale8) ? frame : frame.convertToFormat(QImage::Format_Grayscale8);
+
+    // the frame lies in the local x (lateral) / z (axial) plane, so every pixel maps linearly into the volume
+    const QQuaternion rotation = orientation * QQuaternion::fromAxisAndAngle(1, 0, 0, static_cast<float>(angle));
+    const double mm = micronsPerPixel / 1000.0;
+    const QVector3D lateral = rotation.rotatedVector(QVector3D(1, 0, 0)) * static_cast<float>(mm / voxelSize_);
+    const QVector3D axial = rotation.rotatedVector(QVector3D(0, 0, 1)) * static_cast<float>(mm / voxelSize_);
+    const QVector3D start = (position - rotation.rotatedVector(QVector3D(static_cast<float>(originX / 1000.0), 0, static_cast<float>(originY / 1000.0))))
+        / static_cast<float>(voxelSize_);
+
+    // skip pixels that are much smaller than a voxel
+    const int step = std::max(1, static_cast<int>(voxelSize_ / mm / 2.0));
+    const int w = gray.width(), h = gray.height();
+    const int rows = (h + step - 1) / step;
+
+    parallelFor(rows, [&](int r)
+    {
+        const int y = r * step;
+        const uint8_t* line = gray.constScanLine(y);
+        const QVector3D rowStart = start + axial * static_cast<float>(y);
+        // the brick outlives its lock, which is released before switching bricks
+        std::shared_ptr<Brick> current;
+        uint64_t currentKey = 0;
+        std::unique_lock<std::mutex> lock;
+        for (auto x = 0; x < w; x += step)
+        {
+            if (!line[x])
+                continue;
+
+            const QVector3D p = rowStart + lateral * static_cast<float>(x);
+            const int vx = static_cast<int>(std::floor(p.x() + 0.5f));
+            const int vy = static_cast<int>(std::floor(p.y() + 0.5f));
+            const int vz = static_cast<int>(std::floor(p.z() + 0.5f));
+            const uint64_t key = brickKey(vx >> BrickBits, vy >> BrickBits, vz >> BrickBits);
+            if (!current || key != currentKey)
+            {
+                if (lock.owns_lock())
+                    lock.unlock();
+                current = brick(key);
+                currentKey = key;
+                lock = std::unique_lock<std::mutex>(current->lock_);
+            }
+
+            Voxel& v = current->voxels_[((vz & BrickMask) * BrickSize + (vy & BrickMask)) * BrickSize + (vx & BrickMask)];
+            v.sum_ += line[x];
+            v.weight_ += 1.0f;
+        }
+    });
+
+    // track the bounds of the inserted data so that slices can be centered on the sweep
+    const QVector3D corners[] =
+    {
+        start * static_cast<float>(voxelSize_),
+        (start + lateral * static_cast<float>(w)) * static_cast<float>(voxelSize_),
+        (start + axial * static_cast<float>(h)) * static_cast<float>(voxelSize_),
+        (start + lateral * static_cast<float>(w) + axial * static_cast<float>(h)) * static_cast<float>(voxelSize_)
+    };
+    std::unique_lock<std::shared_mutex> lock(bricksLock_);
+    for (const auto& c : corners)
+    {
+        if (empty_)
+        {
+            minimum_ = maximum_ = c;
+            empty_ = false;
+        }
+        minimum_ = QVector3D(std::min(minimum_.x(), c.x()), std::min(minimum_.y(), c.y()), std::min(minimum_.z(), c.z()));
+        maximum_ = QVector3D(std::max(maximum_.x(), c.x()), std::max(maximum_.y(), c.y()), std::max(maximum_.z(), c.z()));
+    }
+}
+
+/// extracts an arbitrary planar slice from the volume
+/// @param[in] center center of the slice in millimeters
+/// @param[in] u horizontal direction of the slice
+/// @param[in] v vertical direction of the slice
+/// @param[in] w width of the slice in pixels
+/// @param[in] h height of the slice in pixels
+/// @param[in] spacing pixel size of the slice in millimeters
+/// @return the slice as a grayscale image, unfilled voxels are black
+/// @note safe to call while frames are being inserted from another thread
+QImage VolumeCompounder::slice(const QVector3D& center, const QVector3D& u, const QVector3D& v, int w, int h, double spacing) const
+{
+    QImage result(w, h, QImage::Format_Grayscale8);
+    result.fill(0);
+    if (w <= 0 || h <= 0 || spacing <= 0)
+        return result;
+
+    const float scale = static_cast<float>(spacing / voxelSize_);
+    const QVector3D du = u.normalized() * scale, dv = v.normalized() * scale;
+    const QVector3D start = center / static_cast<float>(voxelSize_) - du * (w / 2.0f) - dv * (h / 2.0f);
+
+    parallelFor(h, [&](int y)
+    {
+        uint8_t* line = result.scanLine(y);
+        const QVector3D rowStart = start + dv * static_cast<float>(y);
+        // neighboring pixels mostly fall into the same brick, which is only looked up again when that changes
+        std::shared_ptr<Brick> b;
+        uint64_t currentKey = 0;
+        bool found = false;
+        for (auto x = 0; x < w; x++)
+        {
+            const QVector3D p = rowStart + du * static_cast<float>(x);
+            const int vx = static_cast<int>(std::floor(p.x() + 0.5f));
+            const int vy = static_cast<int>(std::floor(p.y() + 0.5f));
+            const int vz = static_cast<int>(std::floor(p.z() + 0.5f));
+            const uint64_t key = brickKey(vx >> BrickBits, vy >> BrickBits, vz >> BrickBits);
+            if (!found || key != currentKey)
+            {
+                b = findBrick(key);
+                currentKey = key;
+                found = true;
+            }
+            if (!b)
+                continue;
+
+            std::lock_guard<std::mutex> lock(b->lock_);
+            const Voxel& vox = b->voxels_[((vz & BrickMask) * BrickSize + (vy & BrickMask)) * BrickSize + (vx & BrickMask)];
+            if (vox.weight_ > 0)
+                line[x] = static_cast<uint8_t>(std::min(255.0f, vox.sum_ / vox.weight_ + 0.5f));
+        }
+    });
+
+    return result;
+}
+
+/// retrieves the center of the compounded data
+/// @return the center in millimeters
+QVector3D VolumeCompounder::center() const
+{
+    std::shared_lock<std::shared_mutex> lock(bricksLock_);
+    return (minimum_ + maximum_) / 2.0f;
+}
+
+/// retrieves the number of allocated bricks
+/// @return the brick count
+size_t VolumeCompounder::bricks() const
+{
+    std::shared_lock<std::shared_mutex> lock(bricksLock_);
+    return bricks_.size();
+}
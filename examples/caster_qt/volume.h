@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+/// freehand 3d compounding of processed frames into a sparse voxel grid
+/// @details voxels are allocated in cubic bricks on demand, so only the swept region consumes memory. frames are
+///          inserted across the shared thread pool with a lock per brick, which allows slices to be extracted while
+///          a sweep is still in progress. bricks are shared with the threads using them, so a reset while inserting or
+///          slicing only drops them from the map
+class VolumeCompounder
+{
+public:
+    explicit VolumeCompounder(double voxelSize = 0.5);
+
+    void setVoxelSize(double mm);
+    double voxelSize() const { return voxelSize_; }
+    void reset();
+    void insert(const QImage& frame, double micronsPerPixel, double originX, double originY, double angle,
+        const QQuaternion& orientation, const QVector3D& position = QVector3D());
+    QImage slice(const QVector3D& center, const QVector3D& u, const QVector3D& v, int w, int h, double spacing) const;
+    QVector3D center() const;
+    size_t bricks() const;
+
+private:
+    static const int BrickBits = 4;
+    static const int BrickSize = 1 << BrickBits;
+    static const int BrickMask = BrickSize - 1;
+
+    /// single accumulated voxel
+    struct Voxel
+    {
+        float sum_;     ///< sum of the inserted intensities
+        float weight_;  ///< # of inserted samples
+    };
+
+    /// cube of voxels that is allocated on demand
+    struct Brick
+    {
+        Brick() { voxels_.fill({ 0, 0 }); }
+
+        std::mutex lock_;   ///< guards the voxels while inserting or slicing
+        std::array<Voxel, BrickSize * BrickSize * BrickSize> voxels_;   ///< voxel data, x fastest
+    };
+
+    static uint64_t brickKey(int bx, int by, int bz);
+    std::shared_ptr<Brick> findBrick(uint64_t key) const;
+    std::shared_ptr<Brick> brick(uint64_t key);
+
+    double voxelSize_;  ///< voxel size in millimeters
+    mutable std::shared_mutex bricksLock_;  ///< guards the brick map, not the contents of the bricks
+    std::unordered_map<uint64_t, std::shared_ptr<Brick>> bricks_;   ///< allocated bricks
+    QVector3D minimum_; ///< lower bound of the inserted data in millimeters
+    QVector3D maximum_; ///< upper bound of the inserted data in millimeters
+    bool empty_;        ///< flag that no data has been inserted
+};
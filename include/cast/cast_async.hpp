@@ -0,0 +1,689 @@
+#pragma once
+
+/// @file cast_async.hpp
+/// awaitable and blocking wrappers over the asynchronous cast api
+/// @details the api reports asynchronous results through plain function pointers that carry no context. each kind of
+///          operation gets its own queue of pending operations, the operation is queued before the api call is made and
+///          the matching callback completes the oldest pending operation of its kind, which relies on the library
+///          answering requests of one kind in the order they were made. operations of different kinds are independent,
+///          so any number of requests can be in flight at once.
+///
+///          an operation that times out or is cancelled completes right away, its queue entry stays until the library
+///          answers so later answers are still matched to the right requests. if the library will never answer, for
+///          example after the connection dropped, call cast::async::reset() to complete everything still pending.
+///
+///          operations can be awaited from coroutines, waited on from any thread, or both. a waiting coroutine resumes
+///          on the thread that completes the operation (a library thread, or the timer thread on timeout) unless an
+///          executor is given, which then schedules the resumption, for example onto a gui thread.
+///
+/// @code
+///     cast::async::Task<bool> applyPreset()
+///     {
+///         auto gain = cast::async::setParameter("gain", 50).timeout(std::chrono::seconds(2));
+///         auto depth = cast::async::setParameter("depth", 6).timeout(std::chrono::seconds(2));
+///         // both requests are already in flight
+///         co_return (co_await gain).ok() && (co_await depth).ok();
+///     }
+/// @endcode
+
+#if !((defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L)
+#error "cast_async.hpp requires c++20"
+#endif
+
+#include "cast.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cast::async
+{
+    /// outcome of an operation
+    enum class Status
+    {
+        Success,    ///< the library reported success
+        Failure,    ///< the library reported failure
+        Rejected,   ///< the api call itself failed, no request was made
+        Timeout,    ///< no answer arrived in time
+        Cancelled,  ///< cancelled by the caller or by reset()
+    };
+
+    /// schedules the resumption of a waiting coroutine
+    using Executor = std::function<void(std::function<void()>)>;
+
+    /// result of an operation
+    template <class T> struct Result
+    {
+        Status status_ = Status::Cancelled; ///< outcome
+        T value_{};                         ///< value reported by the library
+
+        bool ok() const { return status_ == Status::Success; }
+        explicit operator bool() const { return ok(); }
+    };
+
+    /// connection details reported by castConnect
+    struct Connection
+    {
+        int imagePort_ = 0;         ///< image streaming port
+        int imuPort_ = 0;           ///< imu streaming port
+        bool swRevMatch_ = false;   ///< flag that the software revisions match
+    };
+
+    /// raw data package prepared by castRequestRawData
+    struct RawPackage
+    {
+        int size_ = 0;              ///< size of the package in bytes, 0 if no raw data was buffered
+        std::string extension_;     ///< file extension of the package
+    };
+
+    /// raw data available on the scanner, reported by castRawDataAvailability
+    struct RawAvailability
+    {
+        std::vector<long long> b_;      ///< timestamps of the buffered b frames
+        std::vector<long long> iqrf_;   ///< timestamps of the buffered iq/rf frames
+    };
+
+    namespace detail
+    {
+        /// type independent part of an operation state, used by the timer and by reset()
+        class StateBase
+        {
+        public:
+            virtual ~StateBase() = default;
+            virtual void abort(Status status) = 0;
+        };
+
+        /// shared state of an operation
+        template <class T> class State : public StateBase
+        {
+        public:
+            /// completes the operation, only the first completion counts
+            /// @param[in] status the outcome
+            /// @param[in] value the value reported by the library
+            /// @return true if this call completed the operation
+            bool complete(Status status, T value)
+            {
+                std::coroutine_handle<> waiter;
+                Executor executor;
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    if (result_)
+                        return false;
+                    result_ = Result<T>{ status, std::move(value) };
+                    waiter = std::exchange(waiter_, nullptr);
+                    executor = executor_;
+                }
+                done_.notify_all();
+                if (waiter)
+                {
+                    if (executor)
+                        executor([waiter]() { waiter.resume(); });
+                    else
+                        waiter.resume();
+                }
+                return true;
+            }
+
+            void abort(Status status) override { complete(status, T{}); }
+
+            /// registers a waiting coroutine
+            /// @param[in] h the coroutine
+            /// @return false if the operation already completed and the coroutine should not suspend
+            bool suspend(std::coroutine_handle<> h)
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (result_)
+                    return false;
+                waiter_ = h;
+                return true;
+            }
+
+            void setExecutor(Executor executor)
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                executor_ = std::move(executor);
+            }
+
+            bool ready() const
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                return result_.has_value();
+            }
+
+            Result<T> wait() const
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                done_.wait(lock, [this]() { return result_.has_value(); });
+                return *result_;
+            }
+
+            template <class Rep, class Period> bool waitFor(const std::chrono::duration<Rep, Period>& d) const
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                return done_.wait_for(lock, d, [this]() { return result_.has_value(); });
+            }
+
+        private:
+            mutable std::mutex lock_;
+            mutable std::condition_variable done_;
+            std::optional<Result<T>> result_;
+            std::coroutine_handle<> waiter_;
+            Executor executor_;
+        };
+
+        /// registry of every queue, so reset() can reach them
+        class Registry
+        {
+        public:
+            static Registry& instance()
+            {
+                static Registry r;
+                return r;
+            }
+
+            void add(std::function<void()> reset)
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                resets_.push_back(std::move(reset));
+            }
+
+            void resetAll()
+            {
+                std::vector<std::function<void()>> resets;
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    resets = resets_;
+                }
+                for (auto& r : resets)
+                    r();
+            }
+
+        private:
+            std::mutex lock_;
+            std::vector<std::function<void()>> resets_;
+        };
+
+        /// pending operations of one kind, in the order they were requested
+        template <class Tag, class T> class Queue
+        {
+        public:
+            static Queue& instance()
+            {
+                static Queue q;
+                return q;
+            }
+
+            /// queues an operation and makes the api call
+            /// @param[in] state the operation state
+            /// @param[in] call makes the api call, returns a negative value if no request was made
+            /// @details requests of one kind are issued one at a time, so the queue order matches the request order even
+            ///          when several threads issue requests. the library may answer before the call returns
+            template <class Call> void issue(const std::shared_ptr<State<T>>& state, Call&& call)
+            {
+                std::lock_guard<std::mutex> issuing(issue_);
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    pending_.push_back(state);
+                }
+                if (call() < 0)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(lock_);
+                        auto it = std::find(pending_.begin(), pending_.end(), state);
+                        if (it != pending_.end())
+                            pending_.erase(it);
+                    }
+                    state->complete(Status::Rejected, T{});
+                }
+            }
+
+            /// completes the oldest pending operation, called from the api callback
+            void complete(Status status, T value)
+            {
+                std::shared_ptr<State<T>> state;
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    if (pending_.empty())
+                        return;
+                    state = std::move(pending_.front());
+                    pending_.pop_front();
+                }
+                state->complete(status, std::move(value));
+            }
+
+            /// cancels every pending operation
+            void reset()
+            {
+                std::deque<std::shared_ptr<State<T>>> pending;
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    pending.swap(pending_);
+                }
+                for (auto& s : pending)
+                    s->complete(Status::Cancelled, T{});
+            }
+
+        private:
+            Queue()
+            {
+                Registry::instance().add([this]() { reset(); });
+            }
+
+            std::mutex issue_;  ///< serializes requests of this kind
+            std::mutex lock_;   ///< guards the queue
+            std::deque<std::shared_ptr<State<T>>> pending_;
+        };
+
+        /// expires operations that were not answered in time, runs a single thread started on first use
+        class Timer
+        {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            static Timer& instance()
+            {
+                static Timer t;
+                return t;
+            }
+
+            void add(Clock::time_point deadline, std::weak_ptr<StateBase> state)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    deadlines_.emplace(deadline, std::move(state));
+                    if (!thread_.joinable())
+                        thread_ = std::jthread([this](std::stop_token stop) { run(stop); });
+                }
+                wake_.notify_one();
+            }
+
+            ~Timer()
+            {
+                if (thread_.joinable())
+                {
+                    thread_.request_stop();
+                    wake_.notify_one();
+                }
+            }
+
+        private:
+            Timer() = default;
+
+            void run(std::stop_token stop)
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                while (!stop.stop_requested())
+                {
+                    if (deadlines_.empty())
+                    {
+                        wake_.wait(lock, stop, [this]() { return !deadlines_.empty(); });
+                        continue;
+                    }
+                    const auto next = deadlines_.begin()->first;
+                    if (Clock::now() < next)
+                    {
+                        wake_.wait_until(lock, stop, next, [this, next]() { return !deadlines_.empty() && deadlines_.begin()->first < next; });
+                        continue;
+                    }
+                    auto state = deadlines_.begin()->second.lock();
+                    deadlines_.erase(deadlines_.begin());
+                    lock.unlock();
+                    if (state)
+                        state->abort(Status::Timeout);
+                    lock.lock();
+                }
+            }
+
+            std::mutex lock_;
+            std::condition_variable_any wake_;
+            std::multimap<Clock::time_point, std::weak_ptr<StateBase>> deadlines_;
+            std::jthread thread_;   ///< declared last, so it stops before the members it uses are destroyed
+        };
+
+        struct ConnectTag {};
+        struct DisconnectTag {};
+        struct UserFunctionTag {};
+        struct SetParameterTag {};
+        struct EnableParameterTag {};
+        struct SetPulseTag {};
+        struct AvailabilityTag {};
+        struct RequestRawTag {};
+        struct ReadRawTag {};
+        struct FinishCaptureTag {};
+
+        /// completes an operation answered through CusReturnFn
+        template <class Tag> void onReturn(int ret)
+        {
+            Queue<Tag, int>::instance().complete(ret == CUS_FAILURE ? Status::Failure : Status::Success, ret);
+        }
+    }
+
+    /// an asynchronous operation in flight
+    /// @details can be awaited, waited on, or both, copies refer to the same operation
+    template <class T> class Operation
+    {
+    public:
+        explicit Operation(std::shared_ptr<detail::State<T>> state) : state_(std::move(state)) { }
+
+        /// fails the operation with a timeout if it has not completed in time
+        /// @param[in] d the time allowed
+        /// @return this operation
+        template <class Rep, class Period> Operation& timeout(const std::chrono::duration<Rep, Period>& d)
+        {
+            if (!state_->ready())
+                detail::Timer::instance().add(detail::Timer::Clock::now() + std::chrono::duration_cast<detail::Timer::Clock::duration>(d), state_);
+            return *this;
+        }
+
+        /// resumes awaiting coroutines through an executor
+        /// @param[in] executor schedules the resumption
+        /// @return this operation
+        Operation& via(Executor executor)
+        {
+            state_->setExecutor(std::move(executor));
+            return *this;
+        }
+
+        /// completes the operation as cancelled, the request itself cannot be withdrawn from the scanner
+        void cancel() { state_->abort(Status::Cancelled); }
+        bool ready() const { return state_->ready(); }
+        Result<T> get() const { return state_->wait(); }
+        template <class Rep, class Period> bool waitFor(const std::chrono::duration<Rep, Period>& d) const { return state_->waitFor(d); }
+
+        bool await_ready() const { return state_->ready(); }
+        bool await_suspend(std::coroutine_handle<> h) { return state_->suspend(h); }
+        Result<T> await_resume() const { return state_->wait(); }
+
+    private:
+        std::shared_ptr<detail::State<T>> state_;
+    };
+
+    /// coroutine returning a value, started right away
+    /// @details the coroutine may be awaited once, or waited on with syncWait(). a task destroyed before it finishes is
+    ///          detached and cleans up after itself when it completes
+    template <class T = void> class Task;
+
+    namespace detail
+    {
+        template <class T> struct TaskValue
+        {
+            std::optional<T> value_;
+            void return_value(T v) { value_ = std::move(v); }
+            T take() { return std::move(*value_); }
+        };
+
+        template <> struct TaskValue<void>
+        {
+            void return_void() { }
+            void take() { }
+        };
+
+        template <class T> struct TaskPromise : TaskValue<T>
+        {
+            std::coroutine_handle<> continuation_;
+            std::atomic_bool done_{ false };    ///< set by whichever of completion and await or destruction comes second
+            std::exception_ptr error_;
+
+            struct Final
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<TaskPromise> h) noexcept
+                {
+                    auto& p = h.promise();
+                    if (p.done_.exchange(true))
+                    {
+                        if (p.continuation_)
+                            return p.continuation_;
+                        // the task was destroyed while running
+                        h.destroy();
+                    }
+                    return std::noop_coroutine();
+                }
+                void await_resume() noexcept { }
+            };
+
+            Task<T> get_return_object();
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            Final final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error_ = std::current_exception(); }
+        };
+    }
+
+    template <class T> class Task
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> h) : h_(h) { }
+        Task(Task&& t) noexcept : h_(std::exchange(t.h_, nullptr)) { }
+        Task& operator=(Task&& t) noexcept
+        {
+            if (this != &t)
+            {
+                release();
+                h_ = std::exchange(t.h_, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() { release(); }
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            h_.promise().continuation_ = h;
+            // already finished, continue without suspending
+            return !h_.promise().done_.exchange(true);
+        }
+        T await_resume()
+        {
+            if (h_.promise().error_)
+                std::rethrow_exception(h_.promise().error_);
+            return h_.promise().take();
+        }
+
+    private:
+        void release()
+        {
+            if (h_ && h_.promise().done_.exchange(true))
+                h_.destroy();
+            h_ = nullptr;
+        }
+
+        std::coroutine_handle<promise_type> h_;
+    };
+
+    template <class T> Task<T> detail::TaskPromise<T>::get_return_object()
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+    }
+
+    namespace detail
+    {
+        template <class T> Task<> complete(Task<T> task, std::promise<T>& result)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await task;
+                    result.set_value();
+                }
+                else
+                    result.set_value(co_await task);
+            }
+            catch (...)
+            {
+                result.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    /// blocks until a task finishes
+    /// @param[in] task the task
+    /// @return the value of the task
+    template <class T> T syncWait(Task<T> task)
+    {
+        std::promise<T> result;
+        auto future = result.get_future();
+        detail::complete(std::move(task), result);
+        return future.get();
+    }
+
+    /// completes every pending operation as cancelled
+    /// @details call after the connection dropped, as requests made before will not be answered
+    inline void reset()
+    {
+        detail::Registry::instance().resetAll();
+    }
+
+    /// connects to a scanner, see castConnect
+    inline Operation<Connection> connect(const std::string& ip, unsigned int port, const std::string& cert)
+    {
+        using Q = detail::Queue<detail::ConnectTag, Connection>;
+        auto state = std::make_shared<detail::State<Connection>>();
+        Q::instance().issue(state, [&]()
+        {
+            return castConnect(ip.c_str(), port, cert.c_str(), [](int imagePort, int imuPort, int swRevMatch)
+            {
+                Q::instance().complete(imagePort == CUS_FAILURE ? Status::Failure : Status::Success,
+                                       Connection{ imagePort, imuPort, swRevMatch == CUS_SUCCESS });
+            });
+        });
+        return Operation<Connection>(state);
+    }
+
+    /// disconnects from the scanner, see castDisconnect
+    inline Operation<int> disconnect()
+    {
+        auto state = std::make_shared<detail::State<int>>();
+        detail::Queue<detail::DisconnectTag, int>::instance().issue(state, []()
+        {
+            return castDisconnect(&detail::onReturn<detail::DisconnectTag>);
+        });
+        return Operation<int>(state);
+    }
+
+    /// runs a user function, see castUserFunction
+    inline Operation<int> userFunction(CusUserFunction cmd, double val = 0)
+    {
+        auto state = std::make_shared<detail::State<int>>();
+        detail::Queue<detail::UserFunctionTag, int>::instance().issue(state, [&]()
+        {
+            return castUserFunction(cmd, val, &detail::onReturn<detail::UserFunctionTag>);
+        });
+        return Operation<int>(state);
+    }
+
+    /// sets a parameter, see castSetParameter
+    inline Operation<int> setParameter(const std::string& prm, double val)
+    {
+        auto state = std::make_shared<detail::State<int>>();
+        detail::Queue<detail::SetParameterTag, int>::instance().issue(state, [&]()
+        {
+            return castSetParameter(prm.c_str(), val, &detail::onReturn<detail::SetParameterTag>);
+        });
+        return Operation<int>(state);
+    }
+
+    /// enables or disables a parameter, see castEnableParameter
+    inline Operation<int> enableParameter(const std::string& prm, bool en)
+    {
+        auto state = std::make_shared<detail::State<int>>();
+        detail::Queue<detail::EnableParameterTag, int>::instance().issue(state, [&]()
+        {
+            return castEnableParameter(prm.c_str(), en ? 1 : 0, &detail::onReturn<detail::EnableParameterTag>);
+        });
+        return Operation<int>(state);
+    }
+
+    /// sets a pulse shape, see castSetPulse
+    inline Operation<int> setPulse(const std::string& prm, const std::string& shape)
+    {
+        auto state = std::make_shared<detail::State<int>>();
+        detail::Queue<detail::SetPulseTag, int>::instance().issue(state, [&]()
+        {
+            return castSetPulse(prm.c_str(), shape.c_str(), &detail::onReturn<detail::SetPulseTag>);
+        });
+        return Operation<int>(state);
+    }
+
+    /// lists the buffered raw data, see castRawDataAvailability
+    inline Operation<RawAvailability> rawDataAvailability()
+    {
+        using Q = detail::Queue<detail::AvailabilityTag, RawAvailability>;
+        auto state = std::make_shared<detail::State<RawAvailability>>();
+        Q::instance().issue(state, []()
+        {
+            return castRawDataAvailability([](int res, int nb, const long long* b, int niqrf, const long long* iqrf)
+            {
+                RawAvailability a;
+                if (b && nb > 0)
+                    a.b_.assign(b, b + nb);
+                if (iqrf && niqrf > 0)
+                    a.iqrf_.assign(iqrf, iqrf + niqrf);
+                Q::instance().complete(res < 0 ? Status::Failure : Status::Success, std::move(a));
+            });
+        });
+        return Operation<RawAvailability>(state);
+    }
+
+    /// packages raw data for download, see castRequestRawData
+    inline Operation<RawPackage> requestRawData(long long int start, long long int end, bool lzo)
+    {
+        using Q = detail::Queue<detail::RequestRawTag, RawPackage>;
+        auto state = std::make_shared<detail::State<RawPackage>>();
+        Q::instance().issue(state, [&]()
+        {
+            return castRequestRawData(start, end, lzo ? 1 : 0, [](int res, const char* extension)
+            {
+                Q::instance().complete(res < 0 ? Status::Failure : Status::Success, RawPackage{ res, extension ? extension : "" });
+            });
+        });
+        return Operation<RawPackage>(state);
+    }
+
+    /// downloads a raw data package, see castReadRawData
+    /// @param[in] data the buffer to download into, sized from the package, must stay valid until the operation completes
+    ///            even if it times out or is cancelled, as the library keeps writing into it
+    inline Operation<int> readRawData(void** data)
+    {
+        using Q = detail::Queue<detail::ReadRawTag, int>;
+        auto state = std::make_shared<detail::State<int>>();
+        Q::instance().issue(state, [&]()
+        {
+            return castReadRawData(data, [](int res)
+            {
+                Q::instance().complete(res < 0 ? Status::Failure : Status::Success, res);
+            });
+        });
+        return Operation<int>(state);
+    }
+
+    /// completes a capture, see castFinishCapture
+    inline Operation<int> finishCapture(int id)
+    {
+        auto state = std::make_shared<detail::State<int>>();
+        detail::Queue<detail::FinishCaptureTag, int>::instance().issue(state, [&]()
+        {
+            return castFinishCapture(id, &detail::onReturn<detail::FinishCaptureTag>);
+        });
+        return Operation<int>(state);
+    }
+}